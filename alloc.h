@@ -0,0 +1,110 @@
+#pragma once
+#ifndef CIRCULAR_QUEUE_ALLOC_H__
+#define CIRCULAR_QUEUE_ALLOC_H__
+#include "cq.h"
+#ifdef __linux__
+#include <sys/mman.h>     // For mmap/mremap/madvise
+#include <sys/syscall.h>  // For SYS_mbind
+#include <unistd.h>       // For syscall
+#endif
+
+#ifndef CIRC_HUGEPAGE_SIZE
+#define CIRC_HUGEPAGE_SIZE (size_t(2) << 20)
+#endif
+
+namespace circ {
+
+class numa_allocator {
+    // Storage policy for very large deques: circ::deque<T, uint64_t, circ::numa_allocator>.
+    // Buffers of at least min_bytes are mapped directly, backed by huge pages and optionally
+    // placed on a given NUMA node; smaller ones come from malloc.
+    // Every step degrades gracefully: if MAP_HUGETLB has no reserved pages we fall back to
+    // transparent huge pages via madvise, and a failed mbind leaves the default first-touch policy.
+    // Off Linux this is equivalent to malloc_allocator.
+    int    node_;      // NUMA node to bind to, or -1 for none.
+    bool   hugetlb_;   // Try explicit (MAP_HUGETLB) huge pages first.
+    bool   strict_;    // MPOL_BIND instead of MPOL_PREFERRED.
+    size_t min_bytes_;
+
+    bool mapped(size_t nbytes) const {return nbytes >= min_bytes_;}
+    static size_t mapping_size(size_t nbytes) {
+        return (nbytes + CIRC_HUGEPAGE_SIZE - 1) & ~(CIRC_HUGEPAGE_SIZE - 1);
+    }
+#ifdef __linux__
+    void place(void *ptr, size_t len) const {
+        ::madvise(ptr, len, MADV_HUGEPAGE);
+#ifdef SYS_mbind
+        if(node_ >= 0) {
+            static constexpr unsigned long nbits = sizeof(unsigned long) * CHAR_BIT;
+            unsigned long nodemask[16] = {0};
+            if(unsigned(node_) >= nbits * 16) return;
+            nodemask[node_ / nbits] = 1ul << (node_ % nbits);
+            // MPOL_PREFERRED = 1, MPOL_BIND = 2. Errors leave the default policy in place.
+            ::syscall(SYS_mbind, ptr, len, strict_ ? 2: 1, nodemask, nbits * 16, 0);
+        }
+#endif
+    }
+    void *map(size_t nbytes) const {
+        const size_t len = mapping_size(nbytes);
+        void *ret = MAP_FAILED;
+#ifdef MAP_HUGETLB
+        if(hugetlb_) ret = ::mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+        if(ret == MAP_FAILED) ret = ::mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if(ret == MAP_FAILED) return nullptr;
+        place(ret, len);
+        return ret;
+    }
+#endif
+
+public:
+    numa_allocator(int node=-1, bool hugetlb=false, bool strict=false, size_t min_bytes=CIRC_HUGEPAGE_SIZE):
+        node_(node), hugetlb_(hugetlb), strict_(strict), min_bytes_(min_bytes) {}
+    int node() const {return node_;}
+    void *allocate(size_t nbytes) {
+#ifdef __linux__
+        if(mapped(nbytes)) return map(nbytes);
+#endif
+        return std::malloc(nbytes);
+    }
+    void *reallocate(void *ptr, size_t old_bytes, size_t new_bytes) {
+#ifdef __linux__
+        if(ptr == nullptr) return allocate(new_bytes); // A moved-from deque has no buffer.
+        if(!mapped(old_bytes) && !mapped(new_bytes)) return std::realloc(ptr, new_bytes);
+        if(mapped(old_bytes) && mapped(new_bytes)) {
+            const size_t old_len = mapping_size(old_bytes), new_len = mapping_size(new_bytes);
+            if(old_len == new_len) return ptr;
+#ifdef MREMAP_MAYMOVE
+            // Moves page tables rather than copying. Hugetlb mappings can refuse; copy below instead.
+            void *ret = ::mremap(ptr, old_len, new_len, MREMAP_MAYMOVE);
+            if(ret != MAP_FAILED) {
+                if(new_len > old_len) place(static_cast<char *>(ret) + old_len, new_len - old_len);
+                return ret;
+            }
+#endif
+        }
+        void *ret = allocate(new_bytes);
+        if(ret == nullptr) return nullptr;
+        std::memcpy(ret, ptr, std::min(old_bytes, new_bytes));
+        deallocate(ptr, old_bytes);
+        return ret;
+#else
+        (void)old_bytes;
+        return std::realloc(ptr, new_bytes);
+#endif
+    }
+    void deallocate(void *ptr, size_t nbytes) {
+#ifdef __linux__
+        if(ptr && mapped(nbytes)) {
+            ::munmap(ptr, mapping_size(nbytes));
+            return;
+        }
+#endif
+        (void)nbytes;
+        std::free(ptr);
+    }
+}; // numa_allocator
+
+} // namespace circ
+
+#endif /* #ifndef CIRCULAR_QUEUE_ALLOC_H__ */
@@ -0,0 +1,329 @@
+// Throughput of circ::deque against std::deque, std::queue, a std::vector used as a queue and,
+// when available, boost::circular_buffer; followed by the concurrent containers.
+// c++ -std=c++17 -O3 -march=native -pthread -I.. bench.cpp -o bench
+// ./bench [--counters] [ops per case] [case filter substring]
+// --counters adds IPC and per-op cache misses and branch mispredicts from the hardware counters,
+// where perf_event_open is permitted (see /proc/sys/kernel/perf_event_paranoid).
+#include "cq.h"
+#include "multicast.h"
+#include "broadcast.h"
+#include "sharded.h"
+#include "perf_counters.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <queue>
+#include <thread>
+#if __has_include(<boost/circular_buffer.hpp>)
+#include <boost/circular_buffer.hpp>
+#define CIRC_BENCH_BOOST 1
+#endif
+
+using clk = std::chrono::steady_clock;
+
+// Bytes requested from the heap, so we can report bytes/op.
+// std containers allocate through operator new; circ containers through counting_allocator.
+static std::atomic<uint64_t> heap_bytes(0);
+// Every form is replaced, and kept out of line: inlined into their callers, GCC pairs the malloc
+// and free inside with new and delete expressions and warns (-Wmismatched-new-delete).
+__attribute__((noinline)) void *operator new(size_t n) {
+    heap_bytes.fetch_add(n, std::memory_order_relaxed);
+    if(void *ret = std::malloc(n)) return ret;
+    throw std::bad_alloc();
+}
+__attribute__((noinline)) void *operator new[](size_t n) {return operator new(n);}
+__attribute__((noinline)) void operator delete(void *p) noexcept {std::free(p);}
+__attribute__((noinline)) void operator delete(void *p, size_t) noexcept {std::free(p);}
+__attribute__((noinline)) void operator delete[](void *p) noexcept {std::free(p);}
+__attribute__((noinline)) void operator delete[](void *p, size_t) noexcept {std::free(p);}
+
+struct counting_allocator: circ::malloc_allocator {
+    void *allocate(size_t n) {
+        heap_bytes.fetch_add(n, std::memory_order_relaxed);
+        return std::malloc(n);
+    }
+    void *reallocate(void *p, size_t old_bytes, size_t new_bytes) {
+        if(new_bytes > old_bytes) heap_bytes.fetch_add(new_bytes - old_bytes, std::memory_order_relaxed);
+        return std::realloc(p, new_bytes);
+    }
+};
+
+template<size_t N>
+struct payload {
+    uint32_t v[N / 4];
+    payload(uint64_t x=0) {for(auto &e: v) e = uint32_t(x);}
+    uint64_t key() const {return v[0];}
+};
+
+// Uniform interface over the containers under test.
+template<typename T>
+struct circ_adapter {
+    static constexpr const char *name = "circ::deque";
+    circ::deque<T, uint32_t, counting_allocator> q;
+    void push_back(const T &x) {q.push_back(x);}
+    void push_front(const T &x) {q.push_front(x);}
+    T pop_front() {return q.pop();}
+    T pop_back() {return q.pop_back();}
+    size_t size() const {return q.size();}
+    template<typename F> void iterate(const F &f) const {q.for_each(f);}
+};
+template<typename T>
+struct std_deque_adapter {
+    static constexpr const char *name = "std::deque";
+    std::deque<T> q;
+    void push_back(const T &x) {q.push_back(x);}
+    void push_front(const T &x) {q.push_front(x);}
+    T pop_front() {T ret(q.front()); q.pop_front(); return ret;}
+    T pop_back() {T ret(q.back()); q.pop_back(); return ret;}
+    size_t size() const {return q.size();}
+    template<typename F> void iterate(const F &f) const {for(const auto &x: q) f(x);}
+};
+template<typename T>
+struct std_queue_adapter {
+    // std::queue adds nothing over its std::deque, but users reach for it; only FIFO cases apply.
+    static constexpr const char *name = "std::queue";
+    std::queue<T> q;
+    void push_back(const T &x) {q.push(x);}
+    T pop_front() {T ret(q.front()); q.pop(); return ret;}
+    size_t size() const {return q.size();}
+};
+template<typename T>
+struct vector_adapter {
+    // Pop by advancing a head index; compact once the dead prefix is half the vector.
+    static constexpr const char *name = "std::vector";
+    std::vector<T> q;
+    size_t head = 0;
+    void push_back(const T &x) {q.push_back(x);}
+    void push_front(const T &x) {
+        if(head == 0) {
+            // Open a gap as large as the contents so repeated push_front is amortized O(1).
+            head = std::max(q.size(), size_t(16));
+            q.insert(q.begin(), head, T());
+        }
+        q[--head] = x;
+    }
+    T pop_front() {
+        T ret(q[head++]);
+        if(head * 2 >= q.size()) q.erase(q.begin(), q.begin() + head), head = 0;
+        return ret;
+    }
+    T pop_back() {T ret(q.back()); q.pop_back(); return ret;}
+    size_t size() const {return q.size() - head;}
+    template<typename F> void iterate(const F &f) const {for(size_t i = head; i < q.size(); f(q[i++]));}
+};
+#ifdef CIRC_BENCH_BOOST
+template<typename T>
+struct boost_adapter {
+    // circular_buffer overwrites when full, so grow it by hand the way deque does.
+    static constexpr const char *name = "boost::circular_buffer";
+    boost::circular_buffer<T> q{4};
+    void grow() {if(q.full()) q.set_capacity(q.capacity() * 2);}
+    void push_back(const T &x) {grow(); q.push_back(x);}
+    void push_front(const T &x) {grow(); q.push_front(x);}
+    T pop_front() {T ret(q.front()); q.pop_front(); return ret;}
+    T pop_back() {T ret(q.back()); q.pop_back(); return ret;}
+    size_t size() const {return q.size();}
+    template<typename F> void iterate(const F &f) const {for(const auto &x: q) f(x);}
+};
+#endif
+
+static uint64_t sink;
+static std::atomic<uint64_t> shared_sink(0); // For results from other threads.
+static const char *filter = nullptr;
+static circ::bench::perf_counters *counters = nullptr; // Set by --counters.
+
+struct result {
+    double ns_per_op;
+    double bytes_per_op;
+    size_t nops;
+    circ::bench::perf_counters::sample hw;
+};
+
+template<typename Func>
+static result measure(size_t nops, const Func &func) {
+    const uint64_t bytes = heap_bytes.load();
+    if(counters) counters->start();
+    const auto start = clk::now();
+    func();
+    const auto stop = clk::now();
+    result ret{std::chrono::duration<double, std::nano>(stop - start).count() / nops,
+               double(heap_bytes.load() - bytes) / nops, nops, {}};
+    if(counters) ret.hw = counters->stop();
+    return ret;
+}
+
+static void report(const char *bench, size_t elem, const char *container, result r) {
+    using pc = circ::bench::perf_counters;
+    std::printf("%-14s %4zuB  %-24s %10.3f ns/op %10.3f bytes/op", bench, elem, container, r.ns_per_op, r.bytes_per_op);
+    if(counters) {
+        const auto per_op = [&r](unsigned e) {
+            if(r.hw.valid[e]) std::printf(" %9.3f", r.hw.value[e] / r.nops);
+            else std::printf(" %9s", "-");
+        };
+        if(r.hw.ipc()) std::printf(" %6.2f", r.hw.ipc());
+        else std::printf(" %6s", "-");
+        per_op(pc::INSTRUCTIONS);
+        per_op(pc::L1D_MISSES);
+        per_op(pc::LLC_MISSES);
+        per_op(pc::BRANCH_MISSES);
+    }
+    std::printf("\n");
+}
+
+static bool selected(const char *bench) {
+    return filter == nullptr || std::strstr(bench, filter);
+}
+
+template<template<typename> class Adapter, typename T>
+static void fifo_cases(size_t nops) {
+    const char *const name = Adapter<T>::name;
+    if(selected("fifo")) {
+        // Steady state: a queue of 1024 elements, one push and one pop per op.
+        Adapter<T> a;
+        for(size_t i = 0; i < 1024; a.push_back(T(i++)));
+        report("fifo", sizeof(T), name, measure(nops, [&] {
+            for(size_t i = 0; i < nops; ++i) {
+                a.push_back(T(i));
+                sink += a.pop_front().key();
+            }
+        }));
+    }
+    if(selected("push_back")) {
+        // Growth from empty, then drain: includes every resize.
+        report("push_back", sizeof(T), name, measure(nops, [&] {
+            Adapter<T> a;
+            for(size_t i = 0; i < nops; a.push_back(T(i++)));
+            while(a.size()) sink += a.pop_front().key();
+        }));
+    }
+    if(selected("burst")) {
+        // Bulk traffic: fill 64K, drain it, repeat, on a queue which already has the capacity.
+        Adapter<T> a;
+        for(size_t i = 0; i < 65536; a.push_back(T(i++)));
+        while(a.size()) a.pop_front();
+        const size_t bursts = (nops + 65535) / 65536; // Whole bursts only: report the ops actually run.
+        report("burst", sizeof(T), name, measure(bursts * 65536, [&] {
+            for(size_t b = 0; b < bursts; ++b) {
+                for(size_t i = 0; i < 65536; a.push_back(T(i++)));
+                while(a.size()) sink += a.pop_front().key();
+            }
+        }));
+    }
+}
+
+template<template<typename> class Adapter, typename T>
+static void deque_cases(size_t nops) {
+    const char *const name = Adapter<T>::name;
+    fifo_cases<Adapter, T>(nops);
+    if(selected("iterate")) {
+        Adapter<T> a;
+        for(size_t i = 0; i < 1 << 16; a.push_back(T(i++)));
+        const size_t passes = std::max(size_t(1), nops >> 16);
+        report("iterate", sizeof(T), name, measure(passes << 16, [&] {
+            for(size_t p = 0; p < passes; ++p) a.iterate([](const T &x) {sink += x.key();});
+        }));
+    }
+    if(selected("push_front")) {
+        report("push_front", sizeof(T), name, measure(nops, [&] {
+            Adapter<T> a;
+            for(size_t i = 0; i < nops; a.push_front(T(i++)));
+            while(a.size()) sink += a.pop_back().key();
+        }));
+    }
+    if(selected("mixed")) {
+        // Alternate FIFO and LIFO pops, pushing at both ends, around a steady depth.
+        Adapter<T> a;
+        for(size_t i = 0; i < 1024; a.push_back(T(i++)));
+        report("mixed", sizeof(T), name, measure(nops, [&] {
+            for(size_t i = 0; i < nops; ++i) {
+                if(i & 1) a.push_front(T(i)); else a.push_back(T(i));
+                sink += ((i >> 1) & 1 ? a.pop_back(): a.pop_front()).key();
+            }
+        }));
+    }
+}
+
+template<typename T>
+static void all_containers(size_t nops) {
+    deque_cases<circ_adapter, T>(nops);
+    deque_cases<std_deque_adapter, T>(nops);
+    fifo_cases<std_queue_adapter, T>(nops);
+    deque_cases<vector_adapter, T>(nops);
+#ifdef CIRC_BENCH_BOOST
+    deque_cases<boost_adapter, T>(nops);
+#endif
+}
+
+static void concurrent(size_t nops) {
+    const unsigned nthreads = std::max(2u, std::thread::hardware_concurrency());
+    if(selected("sharded")) {
+        // Every thread pushes and pops its own share; stealing only kicks in when a shard runs dry.
+        circ::sharded_queue<uint64_t> q(nthreads);
+        const size_t per = nops / nthreads;
+        report("sharded", sizeof(uint64_t), "circ::sharded_queue", measure(per * nthreads, [&] {
+            std::vector<std::thread> threads;
+            for(unsigned t = 0; t < nthreads; ++t) threads.emplace_back([&] {
+                uint64_t x, local = 0;
+                for(size_t i = 0; i < per; ++i) {
+                    q.push(i);
+                    if(q.try_pop(x)) local += x;
+                }
+                shared_sink += local;
+            });
+            for(auto &t: threads) t.join();
+        }));
+    }
+    if(selected("multicast")) {
+        // One producer, three consumers each seeing every element; ns per element produced.
+        circ::multicast_ring<uint64_t> ring(4096, 3);
+        ring.follow(2, 1);
+        report("multicast", sizeof(uint64_t), "circ::multicast_ring", measure(nops, [&] {
+            std::vector<std::thread> threads;
+            for(unsigned c = 0; c < 3; ++c) threads.emplace_back([&, c] {
+                uint64_t local = 0;
+                for(size_t seen = 0; seen < nops; seen += ring.consume(c, [&](uint64_t x) {local += x;}));
+                shared_sink += local;
+            });
+            for(size_t i = 0; i < nops; ring.push(i++));
+            for(auto &t: threads) t.join();
+        }));
+    }
+    if(selected("broadcast")) {
+        // Writer cost with two lossy readers attached.
+        circ::broadcast_ring<uint64_t> ring(4096);
+        std::atomic<bool> done(false);
+        std::vector<std::thread> threads;
+        for(unsigned c = 0; c < 2; ++c) threads.emplace_back([&] {
+            auto reader = ring.subscribe();
+            uint64_t x, local = 0;
+            while(!done.load(std::memory_order_relaxed)) if(reader.try_read(x)) local += x;
+            shared_sink += local;
+        });
+        report("broadcast", sizeof(uint64_t), "circ::broadcast_ring", measure(nops, [&] {
+            for(size_t i = 0; i < nops; ring.push(i++));
+        }));
+        done.store(true);
+        for(auto &t: threads) t.join();
+    }
+}
+
+int main(int argc, char **argv) {
+    circ::bench::perf_counters pc;
+    if(argc > 1 && std::strcmp(argv[1], "--counters") == 0) {
+        if(pc.available()) counters = &pc;
+        else std::fprintf(stderr, "Hardware counters unavailable; reporting wall time only.\n");
+        --argc, ++argv;
+    }
+    const size_t nops = argc > 1 ? std::strtoull(argv[1], nullptr, 10): 10000000;
+    if(argc > 2) filter = argv[2];
+    if(counters) std::printf("%-14s %5s  %-24s %16s %19s %6s %9s %9s %9s %9s\n", "case", "elem", "container", "time", "heap",
+                             "IPC", "instr/op", "L1d/op", "LLC/op", "brmiss/op");
+    all_containers<payload<4>>(nops);
+    all_containers<payload<16>>(nops);
+    all_containers<payload<64>>(nops / 4);
+    all_containers<payload<256>>(nops / 16);
+    concurrent(nops);
+    std::fprintf(stderr, "checksum %lu\n", (unsigned long)(sink + shared_sink.load()));
+}
@@ -0,0 +1,50 @@
+// Power-of-two (circ::deque) vs arbitrary capacity (circ::compact_deque).
+// c++ -std=c++17 -O3 -march=native -I.. capacity_bench.cpp -o capacity_bench
+#include "compact.h"
+#include <chrono>
+#include <cstdio>
+
+using clk = std::chrono::steady_clock;
+
+template<typename Q>
+static double fifo(Q &q, size_t depth, size_t nops) {
+    // Keep depth elements queued and cycle through nops push/pop pairs.
+    uint64_t sum = 0;
+    for(size_t i = 0; i < depth; q.push_back(i++));
+    const auto start = clk::now();
+    for(size_t i = 0; i < nops; ++i) {
+        q.push_back(i);
+        sum += q.pop();
+    }
+    const auto stop = clk::now();
+    if(sum == 1) std::fprintf(stderr, "Unreachable\n");
+    while(q.size()) q.pop();
+    return std::chrono::duration<double, std::nano>(stop - start).count() / nops;
+}
+
+template<typename Q>
+static double growth(size_t n) {
+    // Start small and let the queue reach n elements by growing.
+    const auto start = clk::now();
+    Q q(3);
+    for(size_t i = 0; i < n; q.push_back(i++));
+    const auto stop = clk::now();
+    if(q.size() != n) std::fprintf(stderr, "Wrong size\n");
+    return std::chrono::duration<double, std::nano>(stop - start).count() / n;
+}
+
+int main(int argc, char **argv) {
+    const size_t nops = argc > 1 ? std::strtoull(argv[1], nullptr, 10): 50000000;
+    std::printf("%-8s  %-14s  %-10s  %-14s  %-10s\n", "depth", "deque bytes", "deque ns", "compact bytes", "compact ns");
+    for(const size_t depth: {1000, 1025, 100000, 1048577}) {
+        circ::deque<uint64_t, uint64_t> d(depth);
+        circ::compact_deque<uint64_t, uint64_t> c(depth + 1);
+        const double dt = fifo(d, depth, nops), ct = fifo(c, depth, nops);
+        std::printf("%-8zu  %-14zu  %-10.3f  %-14zu  %-10.3f\n", depth,
+                    size_t(d.capacity() + 1) * sizeof(uint64_t), dt,
+                    size_t(c.capacity()) * sizeof(uint64_t), ct);
+    }
+    const size_t n = nops / 4;
+    std::printf("growth to %zu: deque %.3f ns/push, compact (1.5x) %.3f ns/push\n", n,
+                growth<circ::deque<uint64_t, uint64_t>>(n), growth<circ::compact_deque<uint64_t, uint64_t>>(n));
+}
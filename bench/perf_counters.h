@@ -0,0 +1,109 @@
+#pragma once
+#ifndef CIRCULAR_QUEUE_PERF_COUNTERS_H__
+#define CIRCULAR_QUEUE_PERF_COUNTERS_H__
+// Hardware performance counters for the benchmarks, via perf_event_open(2).
+// Each event is opened on its own, so an event the CPU or hypervisor lacks just reads as unavailable;
+// if perf events are disabled altogether (perf_event_paranoid, containers, non-Linux), everything is.
+#include <cstdint>
+#include <cstring>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace circ {
+namespace bench {
+
+class perf_counters {
+public:
+    enum event: unsigned {
+        CYCLES,
+        INSTRUCTIONS,
+        BRANCH_MISSES,
+        L1D_MISSES,
+        LLC_MISSES,
+        NEVENTS
+    };
+    struct sample {
+        double value[NEVENTS];
+        bool   valid[NEVENTS];
+        double ipc() const {return valid[CYCLES] && valid[INSTRUCTIONS] && value[CYCLES] ? value[INSTRUCTIONS] / value[CYCLES]: 0.;}
+    };
+
+private:
+    int fds_[NEVENTS];
+#ifdef __linux__
+    static int open_event(uint32_t type, uint64_t config) {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.disabled = 1;
+        attr.inherit = 1; // Count threads spawned while enabled, for the concurrent cases.
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        return int(::syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+    }
+#endif
+
+public:
+    perf_counters() {
+        for(auto &fd: fds_) fd = -1;
+#ifdef __linux__
+        fds_[CYCLES] = open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+        fds_[INSTRUCTIONS] = open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+        fds_[BRANCH_MISSES] = open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+        fds_[L1D_MISSES] = open_event(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+        fds_[LLC_MISSES] = open_event(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+#endif
+    }
+    perf_counters(const perf_counters &) = delete;
+    perf_counters &operator=(const perf_counters &) = delete;
+    ~perf_counters() {
+#ifdef __linux__
+        for(const int fd: fds_) if(fd >= 0) ::close(fd);
+#endif
+    }
+    bool available() const {
+        for(const int fd: fds_) if(fd >= 0) return true;
+        return false;
+    }
+    static const char *name(unsigned e) {
+        static const char *const names[] = {"cycles", "instructions", "branch-misses", "L1d-misses", "LLC-misses"};
+        return names[e];
+    }
+    void start() {
+#ifdef __linux__
+        for(const int fd: fds_) if(fd >= 0) {
+            ::ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+            ::ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+#endif
+    }
+    // Stops counting. Values are scaled up if the kernel had to multiplex counters.
+    sample stop() {
+        sample ret;
+        for(unsigned e = 0; e < NEVENTS; ++e) {
+            ret.value[e] = 0.;
+            ret.valid[e] = false;
+#ifdef __linux__
+            if(fds_[e] < 0) continue;
+            ::ioctl(fds_[e], PERF_EVENT_IOC_DISABLE, 0);
+            uint64_t buf[3]; // value, time enabled, time running
+            if(::read(fds_[e], buf, sizeof(buf)) != ssize_t(sizeof(buf)) || buf[2] == 0) continue;
+            ret.value[e] = double(buf[0]) * double(buf[1]) / double(buf[2]);
+            ret.valid[e] = true;
+#endif
+        }
+        return ret;
+    }
+}; // perf_counters
+
+} // namespace bench
+} // namespace circ
+
+#endif /* #ifndef CIRCULAR_QUEUE_PERF_COUNTERS_H__ */
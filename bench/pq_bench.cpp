@@ -0,0 +1,113 @@
+// Monotone priority queues: circ::radix_heap and circ::bucket_queue against std::priority_queue,
+// on Dijkstra over a random graph and on the hold model (pop the minimum, push it back a random step later).
+// c++ -std=c++17 -O3 -march=native -I.. pq_bench.cpp -o pq_bench
+// ./pq_bench [nodes] [hold queue size]
+#include "radix.h"
+#include "bucket.h"
+#include <chrono>
+#include <cstdio>
+#include <queue>
+#include <random>
+
+using clk = std::chrono::steady_clock;
+
+struct edge {
+    uint32_t to;
+    uint32_t w;
+};
+using graph = std::vector<std::vector<edge>>;
+
+// Uniform interface: push(key, node), pop(key) -> node.
+struct heap_adapter {
+    static constexpr const char *name = "std::priority_queue";
+    using P = std::pair<uint64_t, uint32_t>;
+    std::priority_queue<P, std::vector<P>, std::greater<P>> q;
+    heap_adapter(uint64_t) {}
+    void push(uint64_t key, uint32_t v) {q.emplace(key, v);}
+    uint32_t pop(uint64_t &key) {
+        const P ret = q.top();
+        q.pop();
+        key = ret.first;
+        return ret.second;
+    }
+    bool empty() const {return q.empty();}
+};
+struct radix_adapter {
+    static constexpr const char *name = "circ::radix_heap";
+    circ::radix_heap<uint64_t, uint32_t> q;
+    radix_adapter(uint64_t) {}
+    void push(uint64_t key, uint32_t v) {q.push(key, v);}
+    uint32_t pop(uint64_t &key) {return q.pop(key);}
+    bool empty() const {return q.empty();}
+};
+struct bucket_adapter {
+    static constexpr const char *name = "circ::bucket_queue";
+    circ::bucket_queue<uint32_t> q;
+    bucket_adapter(uint64_t range): q(range) {}
+    void push(uint64_t key, uint32_t v) {q.push(key, v);}
+    uint32_t pop(uint64_t &key) {return q.pop(key);}
+    bool empty() const {return q.empty();}
+};
+
+static graph random_graph(uint32_t n, unsigned degree, uint32_t max_weight) {
+    std::mt19937 rng(13);
+    graph g(n);
+    for(auto &adj: g)
+        for(unsigned k = 0; k < degree; ++k) adj.push_back(edge{uint32_t(rng() % n), uint32_t(rng() % max_weight + 1)});
+    return g;
+}
+
+template<typename Q>
+static uint64_t dijkstra(const graph &g, uint32_t max_weight, double &ms) {
+    std::vector<uint64_t> dist(g.size(), UINT64_MAX);
+    const auto start = clk::now();
+    Q q(uint64_t(max_weight) + 1);
+    dist[0] = 0;
+    q.push(0, 0);
+    while(!q.empty()) {
+        uint64_t d;
+        const uint32_t u = q.pop(d);
+        if(d != dist[u]) continue; // Stale entry.
+        for(const edge &e: g[u]) if(d + e.w < dist[e.to]) q.push(dist[e.to] = d + e.w, e.to);
+    }
+    ms = std::chrono::duration<double, std::milli>(clk::now() - start).count();
+    uint64_t sum = 0;
+    for(const uint64_t d: dist) sum += d == UINT64_MAX ? 0: d;
+    return sum;
+}
+
+template<typename Q>
+static double hold(size_t n, uint32_t max_step, size_t nops) {
+    std::mt19937 rng(7);
+    Q q(uint64_t(max_step) + 1);
+    for(size_t i = 0; i < n; ++i) q.push(rng() % max_step, uint32_t(i));
+    uint64_t key, sum = 0;
+    const auto start = clk::now();
+    for(size_t i = 0; i < nops; ++i) {
+        const uint32_t v = q.pop(key);
+        sum += v;
+        q.push(key + rng() % max_step, v);
+    }
+    const auto stop = clk::now();
+    if(sum == 1) std::fprintf(stderr, "Unreachable\n");
+    return std::chrono::duration<double, std::nano>(stop - start).count() / nops;
+}
+
+template<typename Q>
+static void run(const graph &g, uint32_t max_weight, size_t hold_n) {
+    double ms;
+    const uint64_t check = dijkstra<Q>(g, max_weight, ms);
+    std::printf("%-22s  weights <= %-8u  dijkstra %9.1f ms  hold %7.1f ns/op  (checksum %lu)\n",
+                Q::name, max_weight, ms, hold<Q>(hold_n, max_weight, hold_n * 4), (unsigned long)check);
+}
+
+int main(int argc, char **argv) {
+    const uint32_t nodes = argc > 1 ? std::atoi(argv[1]): 1 << 20;
+    const size_t hold_n = argc > 2 ? std::strtoull(argv[2], nullptr, 10): 1 << 20;
+    for(const uint32_t max_weight: {100u, 1u << 20}) {
+        const graph g = random_graph(nodes, 8, max_weight);
+        run<heap_adapter>(g, max_weight, hold_n);
+        run<radix_adapter>(g, max_weight, hold_n);
+        if(max_weight <= 1024) run<bucket_adapter>(g, max_weight, hold_n); // Needs one bucket per distinct pending key.
+    }
+}
@@ -0,0 +1,86 @@
+// Filling many byte rings from pipes: one readv per descriptor (circ::read_from_fd)
+// against one io_uring_enter per batch (circ::uring_reader).
+// c++ -std=c++17 -O3 -march=native -I.. uring_bench.cpp -o uring_bench
+// ./uring_bench [pipes] [rounds] [bytes per pipe per round]
+#include "uring.h"
+#include <chrono>
+#include <cstdio>
+#include <fcntl.h>
+
+using clk = std::chrono::steady_clock;
+using ring = circ::deque<char>;
+
+struct pipes {
+    std::vector<int> rd, wr;
+    pipes(unsigned n) {
+        for(unsigned i = 0; i < n; ++i) {
+            int fds[2];
+            if(::pipe(fds)) throw std::runtime_error("pipe failed (raise the descriptor limit?). Abort!");
+            ::fcntl(fds[0], F_SETFL, O_NONBLOCK);
+            rd.push_back(fds[0]);
+            wr.push_back(fds[1]);
+        }
+    }
+    ~pipes() {
+        for(const int fd: rd) ::close(fd);
+        for(const int fd: wr) ::close(fd);
+    }
+    void fill(const std::vector<char> &chunk) {
+        for(const int fd: wr) if(::write(fd, chunk.data(), chunk.size()) != ssize_t(chunk.size())) throw std::runtime_error("short write. Abort!");
+    }
+};
+
+static uint64_t consume(ring &q) {
+    // Stand-in for a protocol parser: look at the data, then drop it.
+    uint64_t ret = q.size() ? uint64_t(q.front()) + q.size(): 0;
+    q.discard_front(q.size());
+    return ret;
+}
+
+int main(int argc, char **argv) {
+    const unsigned npipes = argc > 1 ? std::atoi(argv[1]): 256;
+    const unsigned rounds = argc > 2 ? std::atoi(argv[2]): 2000;
+    const size_t chunk_bytes = argc > 3 ? std::strtoull(argv[3], nullptr, 10): 512;
+    const std::vector<char> chunk(chunk_bytes, 'x');
+    pipes p(npipes);
+    std::vector<ring> rings(npipes);
+    for(auto &r: rings) r.reserve(chunk_bytes * 2);
+    uint64_t sink = 0;
+    double fill_ns = 0, readv_ns = 0, uring_ns = 0;
+    size_t bytes = 0;
+
+    for(unsigned r = 0; r < rounds; ++r) {
+        auto t0 = clk::now();
+        p.fill(chunk);
+        auto t1 = clk::now();
+        for(unsigned i = 0; i < npipes; ++i) {
+            if(circ::read_from_fd(rings[i], p.rd[i], chunk_bytes) > 0) bytes += rings[i].size();
+            sink += consume(rings[i]);
+        }
+        auto t2 = clk::now();
+        fill_ns += std::chrono::duration<double, std::nano>(t1 - t0).count();
+        readv_ns += std::chrono::duration<double, std::nano>(t2 - t1).count();
+    }
+    circ::uring_reader<ring> reader(circ::roundup(npipes));
+    for(unsigned r = 0; r < rounds; ++r) {
+        p.fill(chunk);
+        auto t1 = clk::now();
+        for(unsigned i = 0; i < npipes; ++i) reader.prepare(rings[i], p.rd[i], chunk_bytes);
+        reader.submit(npipes);
+        while(reader.inflight()) {
+            reader.complete([&](ring &q, int, ssize_t res) {
+                if(res > 0) bytes += q.size();
+                sink += consume(q);
+            });
+            if(reader.inflight()) reader.submit(reader.inflight());
+        }
+        auto t2 = clk::now();
+        uring_ns += std::chrono::duration<double, std::nano>(t2 - t1).count();
+    }
+    const double nreads = double(npipes) * rounds;
+    std::printf("%u pipes x %u rounds x %zu bytes (pipe writes: %.1f ns each)\n", npipes, rounds, chunk_bytes, fill_ns / nreads);
+    std::printf("read_from_fd          %10.1f ns/read  1 syscall per read\n", readv_ns / nreads);
+    if(reader.async()) std::printf("uring_reader          %10.1f ns/read  1 syscall per %u reads\n", uring_ns / nreads, npipes);
+    else std::printf("uring_reader (no io_uring; emulated with readv) %10.1f ns/read\n", uring_ns / nreads);
+    std::fprintf(stderr, "checksum %lu bytes %zu\n", (unsigned long)sink, bytes);
+}
@@ -0,0 +1,113 @@
+#pragma once
+#ifndef CIRCULAR_QUEUE_BROADCAST_H__
+#define CIRCULAR_QUEUE_BROADCAST_H__
+#include "cq.h"
+#include <atomic>      // For std::atomic
+#include <memory>      // For std::unique_ptr
+
+namespace circ {
+
+template<typename T, typename SizeType=uint32_t>
+class broadcast_ring {
+    // A single-writer, many-reader ring which overwrites the oldest element instead of blocking.
+    // The writer never looks at its readers, so a push costs the same regardless of how many there are.
+    // Each slot carries a seqlock: odd while being written, 2 * (sequence + 1) once published.
+    // A reader which finds a newer sequence than it expects in its slot has been lapped;
+    // it skips ahead to the oldest element still likely to be intact and counts what it dropped.
+    // T must be trivially copyable, as readers may copy a slot while it is being overwritten
+    // and only discard the result afterwards.
+    static_assert(std::is_unsigned<SizeType>::value, "Must be unsigned");
+    static_assert(std::is_trivially_copyable<T>::value, "broadcast_ring requires trivially copyable T");
+    struct slot {
+        std::atomic<uint64_t> seq_;
+        alignas(T) unsigned char value_[sizeof(T)];
+        slot(): seq_(0) {}
+    };
+    struct alignas(CIRC_CACHELINE_SIZE) cursor {
+        std::atomic<uint64_t> seq_;
+        cursor(): seq_(0) {}
+    };
+
+    SizeType                mask_;
+    std::unique_ptr<slot[]> slots_;
+    cursor                  head_;
+
+public:
+    using size_type = SizeType;
+    class reader {
+        const broadcast_ring *ref_;
+        uint64_t              pos_;
+        uint64_t              dropped_;
+    public:
+        reader(const broadcast_ring &ref, uint64_t pos): ref_(&ref), pos_(pos), dropped_(0) {}
+        // Copies the next element into out. Returns false if the writer has not produced it yet.
+        bool try_read(T &out) {
+            const auto &r = *ref_;
+            for(;;) {
+                const slot &s = r.slots_[pos_ & r.mask_];
+                const uint64_t expected = (pos_ + 1) << 1;
+                const uint64_t before = s.seq_.load(std::memory_order_acquire);
+                if(before < expected) return false;
+                if(before == expected) {
+                    std::memcpy(&out, s.value_, sizeof(T));
+                    std::atomic_thread_fence(std::memory_order_acquire);
+                    if(s.seq_.load(std::memory_order_relaxed) == before) {
+                        ++pos_;
+                        return true;
+                    }
+                }
+                // Lapped by the writer: resynchronize.
+                const uint64_t head = r.head_.seq_.load(std::memory_order_acquire);
+                const uint64_t oldest = head > r.mask_ ? head - r.mask_: 0;
+                if(oldest > pos_) {
+                    dropped_ += oldest - pos_;
+                    pos_ = oldest;
+                } else ++dropped_, ++pos_; // Overwritten during the copy; only this one is lost.
+            }
+        }
+        // Skip everything currently published.
+        void skip_to_latest() {
+            const uint64_t head = ref_->head_.seq_.load(std::memory_order_acquire);
+            if(head > pos_) dropped_ += head - pos_, pos_ = head;
+        }
+        uint64_t position() const noexcept {return pos_;}
+        uint64_t dropped()  const noexcept {return dropped_;}
+        // Approximate; the writer may be running concurrently.
+        size_t lag() const {return ref_->head_.seq_.load(std::memory_order_relaxed) - pos_;}
+    };
+
+    broadcast_ring(SizeType size=3):
+        mask_(roundup(std::max(size, SizeType(2))) - 1),
+        slots_(new slot[size_t(mask_) + 1]) {}
+    broadcast_ring(const broadcast_ring &) = delete;
+    broadcast_ring &operator=(const broadcast_ring &) = delete;
+
+    void push(const T &value) {
+        const uint64_t seq = head_.seq_.load(std::memory_order_relaxed);
+        slot &s = slots_[seq & mask_];
+        s.seq_.store((seq << 1) | 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        std::memcpy(s.value_, &value, sizeof(T));
+        s.seq_.store((seq + 1) << 1, std::memory_order_release);
+        head_.seq_.store(seq + 1, std::memory_order_release);
+    }
+    void push_back(const T &value) {
+        push(value); // Interface compatibility
+    }
+    // A reader starting with the next element to be pushed.
+    reader subscribe() const {
+        return reader(*this, head_.seq_.load(std::memory_order_acquire));
+    }
+    // A reader starting with the oldest element still held.
+    reader subscribe_oldest() const {
+        const uint64_t head = head_.seq_.load(std::memory_order_acquire);
+        return reader(*this, head > mask_ ? head - mask_: 0);
+    }
+    uint64_t published() const {return head_.seq_.load(std::memory_order_acquire);}
+    size_type capacity() const noexcept {return mask_ + 1;}
+    size_type mask() const noexcept {return mask_;}
+}; // broadcast_ring
+
+} // namespace circ
+
+#endif /* #ifndef CIRCULAR_QUEUE_BROADCAST_H__ */
@@ -0,0 +1,106 @@
+#pragma once
+#ifndef CIRCULAR_QUEUE_BUCKET_H__
+#define CIRCULAR_QUEUE_BUCKET_H__
+#include "cq.h"
+#include <memory>      // For std::unique_ptr
+
+namespace circ {
+
+template<typename T, typename SizeType=uint32_t>
+class bucket_queue {
+    // A monotone priority queue over integer priorities (Dial's algorithm), for schedulers and
+    // shortest paths with small integer weights.
+    // Priorities in flight must lie within a window [min, min + range): bucket p & mask holds every
+    // element of priority p, FIFO, in a circ::deque. A bitmap of non-empty buckets finds the next
+    // minimum with count-trailing-zeros over 64 buckets at a time, starting from the current minimum,
+    // so push is O(1) and pop is O(1) amortized when priorities never fall below the last one popped.
+    // As with Dijkstra, decrease-key is done by pushing again and skipping stale entries.
+    using bucket_type = deque<T, SizeType>;
+    std::unique_ptr<bucket_type[]> buckets_;
+    std::unique_ptr<uint64_t[]>    bits_;
+    uint64_t                       mask_;
+    uint64_t                       cur_;   // Lower bound on every queued priority.
+    size_t                         size_;
+
+    size_t nwords() const {return (mask_ >> 6) + 1;}
+    // Advance cur_ to the smallest queued priority. With nothing queued the scan would never end, so throw.
+    void seek() {
+        if(__builtin_expect(size_ == 0, 0)) throw std::runtime_error("Reading the top of an empty bucket_queue. Abort!");
+        const uint64_t start = cur_ & mask_;
+        size_t w = start >> 6;
+        uint64_t word = bits_[w] & (~uint64_t(0) << (start & 63));
+        for(size_t scanned = 0; word == 0; word = bits_[w]) {
+            w = w + 1 == nwords() ? 0: w + 1;
+            assert(++scanned <= nwords());
+            (void)scanned;
+        }
+        const uint64_t idx = (uint64_t(w) << 6) | __builtin_ctzll(word);
+        cur_ += (idx - start) & mask_;
+    }
+
+public:
+    using size_type = size_t;
+    using value_type = T;
+    using priority_type = uint64_t;
+    // range: the largest spread of priorities queued at once, e.g. one more than the maximum edge weight.
+    bucket_queue(uint64_t range=64, uint64_t min_priority=0):
+        mask_(std::max(roundup(range), uint64_t(64)) - 1), cur_(min_priority), size_(0)
+    {
+        buckets_.reset(new bucket_type[mask_ + 1]);
+        bits_.reset(new uint64_t[nwords()]());
+    }
+    template<typename... Args>
+    T &push(uint64_t priority, Args &&... args) {
+        if(__builtin_expect(priority < cur_ || priority - cur_ > mask_, 0)) {
+            if(size_ == 0) cur_ = priority; // An empty queue can move its window anywhere.
+            else throw std::runtime_error("Priority " + std::to_string(priority) + " is outside the bucket_queue window [" + std::to_string(cur_) + ", " + std::to_string(cur_ + mask_) + "]. Abort!");
+        }
+        const uint64_t i = priority & mask_;
+        bits_[i >> 6] |= uint64_t(1) << (i & 63);
+        ++size_;
+        return buckets_[i].push_back(std::forward<Args>(args)...);
+    }
+    template<typename... Args>
+    T &emplace(uint64_t priority, Args &&... args) {
+        return push(priority, std::forward<Args>(args)...); // Interface compatibility.
+    }
+    // Smallest queued priority. Throws if empty.
+    uint64_t top_priority() {
+        seek();
+        return cur_;
+    }
+    T &top() {
+        seek();
+        return buckets_[cur_ & mask_].front();
+    }
+    // Removes an element of the smallest priority, FIFO among equals.
+    T pop() {
+        if(__builtin_expect(size_ == 0, 0)) throw std::runtime_error("Popping item from empty buffer. Abort!");
+        seek();
+        const uint64_t i = cur_ & mask_;
+        bucket_type &b = buckets_[i];
+        T ret(b.pop());
+        if(b.size() == 0) bits_[i >> 6] &= ~(uint64_t(1) << (i & 63));
+        --size_;
+        return ret;
+    }
+    T pop(uint64_t &priority) {
+        T ret(pop());
+        priority = cur_;
+        return ret;
+    }
+    void clear() {
+        for(size_t w = 0; w < nwords(); ++w)
+            for(uint64_t word = bits_[w]; word; word &= word - 1)
+                buckets_[(w << 6) | __builtin_ctzll(word)].clear();
+        std::memset(bits_.get(), 0, nwords() * sizeof(uint64_t));
+        size_ = 0;
+    }
+    size_t size()    const noexcept {return size_;}
+    bool empty()     const noexcept {return size_ == 0;}
+    uint64_t range() const noexcept {return mask_ + 1;}
+}; // bucket_queue
+
+} // namespace circ
+
+#endif /* #ifndef CIRCULAR_QUEUE_BUCKET_H__ */
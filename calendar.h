@@ -0,0 +1,158 @@
+#pragma once
+#ifndef CIRCULAR_QUEUE_CALENDAR_H__
+#define CIRCULAR_QUEUE_CALENDAR_H__
+#include "cq.h"
+#include <memory>      // For std::unique_ptr
+
+namespace circ {
+
+template<typename T, typename Time=double, typename SizeType=uint32_t>
+class calendar_queue {
+    // Brown's calendar queue, a priority queue for discrete-event simulation with O(1) expected
+    // enqueue and dequeue when event times are spread evenly.
+    // Time is cut into days of width_; a power-of-two ring of buckets holds day d in bucket d & mask_,
+    // so one bucket mixes events from different "years". Dequeue walks the days from the last event
+    // popped, taking the earliest event in the current bucket if it falls within the current day.
+    // Buckets are circ::deques kept unsorted: with the width tuned to about three mean gaps, they
+    // hold a few events each, so a linear scan beats keeping them ordered.
+    // The bucket count doubles or halves as size() crosses 2x or 0.5x of it, and each resize re-estimates
+    // the day width from the spacing of the earliest events, following changes in event density.
+    // A dequeue which finds nothing in a whole year of days also triggers re-estimation.
+    // Equal times are dequeued in insertion order, so runs are deterministic.
+    static_assert(std::is_arithmetic<Time>::value, "Event times must be numbers");
+    struct entry {
+        Time     time;
+        uint64_t seq;
+        T        value;
+        bool operator<(const entry &o) const {return time < o.time || (time == o.time && seq < o.seq);}
+    };
+    using bucket_type = deque<entry, SizeType>;
+    std::unique_ptr<bucket_type[]> buckets_;
+    uint64_t                       mask_;
+    Time                           width_;
+    uint64_t                       day_;       // Day of the bucket dequeue looks at next.
+    Time                           last_time_; // Time of the last event dequeued.
+    uint64_t                       seq_;
+    size_t                         size_;
+    bool                           retune_;    // Set when a dequeue had to search a whole year.
+
+    uint64_t day_of(Time t) const {return uint64_t(t / width_);}
+    static SizeType earliest(const bucket_type &b) {
+        SizeType best = 0;
+        for(SizeType i = 1; i < b.size(); ++i) if(b[i] < b[best]) best = i;
+        return best;
+    }
+    entry take(bucket_type &b, SizeType i) {
+        // Order within a bucket doesn't matter: fill the hole with the back element.
+        if(i + 1 != b.size()) std::swap(b[i], b.back());
+        --size_;
+        return b.pop_back();
+    }
+    // Locate the earliest event: returns its bucket and sets idx. Requires size_ > 0.
+    bucket_type &find_min(SizeType &idx) {
+        assert(size_ != 0);
+        for(uint64_t n = 0; n <= mask_; ++n, ++day_) {
+            bucket_type &b = buckets_[day_ & mask_];
+            if(b.size() == 0) continue;
+            idx = earliest(b);
+            if(day_of(b[idx].time) <= day_) return b;
+        }
+        // A whole year without an event: jump straight to the earliest one.
+        bucket_type *best = nullptr;
+        for(uint64_t i = 0; i <= mask_; ++i) {
+            bucket_type &b = buckets_[i];
+            if(b.size() == 0) continue;
+            const SizeType j = earliest(b);
+            if(best == nullptr || b[j] < (*best)[idx]) best = &b, idx = j;
+        }
+        day_ = day_of((*best)[idx].time);
+        retune_ = true; // Days are too narrow for the current density.
+        return *best;
+    }
+    void resize(uint64_t nbuckets) {
+        std::vector<entry> all;
+        all.reserve(size_);
+        for(uint64_t i = 0; i <= mask_; ++i)
+            while(buckets_[i].size()) all.push_back(buckets_[i].pop_back());
+        width_ = estimate_width(all);
+        buckets_.reset(new bucket_type[nbuckets]);
+        mask_ = nbuckets - 1;
+        for(auto &e: all) buckets_[day_of(e.time) & mask_].push_back(std::move(e));
+        day_ = day_of(last_time_);
+    }
+    Time estimate_width(std::vector<entry> &all) const {
+        // Three times the mean gap between the earliest events, ignoring gaps over twice the mean.
+        const size_t k = std::min(all.size(), size_t(25));
+        if(k < 2) return width_;
+        std::partial_sort(all.begin(), all.begin() + k, all.end());
+        const double total = double(all[k - 1].time) - double(all[0].time);
+        const double mean = total / (k - 1);
+        double sum = 0;
+        size_t n = 0;
+        for(size_t i = 1; i < k; ++i) {
+            const double gap = double(all[i].time) - double(all[i - 1].time);
+            if(gap <= 2 * mean) sum += gap, ++n;
+        }
+        const double w = n && sum > 0 ? 3 * sum / n: 0;
+        if(w <= 0) return width_;
+        CIRC_CONSTIF(std::is_integral<Time>::value) return std::max(Time(1), Time(w));
+        return Time(w);
+    }
+
+public:
+    using value_type = T;
+    using time_type = Time;
+    calendar_queue(Time width=Time(1), uint64_t nbuckets=16):
+        buckets_(new bucket_type[std::max(roundup(nbuckets), uint64_t(2))]),
+        mask_(std::max(roundup(nbuckets), uint64_t(2)) - 1), width_(width), day_(0), last_time_(0), seq_(0), size_(0), retune_(false)
+    {
+        if(__builtin_expect(!(width > Time(0)), 0)) throw std::runtime_error("Calendar day width must be positive. Abort!");
+    }
+    // Events may not be scheduled before the last one dequeued.
+    template<typename... Args>
+    T &push(Time time, Args &&... args) {
+        if(__builtin_expect(time < last_time_, 0)) throw std::runtime_error("Event scheduled in the past of a calendar_queue. Abort!");
+        if(__builtin_expect(size_ >= 2 * (mask_ + 1), 0)) resize((mask_ + 1) * 2);
+        const uint64_t day = day_of(time);
+        if(day < day_) day_ = day; // top_time() may have looked ahead past this day.
+        bucket_type &b = buckets_[day & mask_];
+        ++size_;
+        return b.push_back(entry{time, seq_++, T(std::forward<Args>(args)...)}).value;
+    }
+    template<typename... Args>
+    T &emplace(Time time, Args &&... args) {
+        return push(time, std::forward<Args>(args)...); // Interface compatibility.
+    }
+    // Time of the earliest event. Requires !empty().
+    Time top_time() {
+        SizeType i;
+        return find_min(i)[i].time;
+    }
+    T pop() {
+        Time t;
+        return pop(t);
+    }
+    T pop(Time &time) {
+        if(__builtin_expect(size_ == 0, 0)) throw std::runtime_error("Popping item from empty buffer. Abort!");
+        SizeType i;
+        bucket_type &b = find_min(i);
+        entry e(take(b, i));
+        time = last_time_ = e.time;
+        if(__builtin_expect(size_ < (mask_ + 1) / 2 && mask_ > 1, 0)) resize((mask_ + 1) / 2);
+        else if(__builtin_expect(retune_, 0)) resize(mask_ + 1);
+        retune_ = false;
+        return std::move(e.value);
+    }
+    void clear() {
+        for(uint64_t i = 0; i <= mask_; ++i) buckets_[i].clear();
+        size_ = 0;
+    }
+    size_t size()     const noexcept {return size_;}
+    bool empty()      const noexcept {return size_ == 0;}
+    Time width()      const noexcept {return width_;}
+    uint64_t buckets() const noexcept {return mask_ + 1;}
+}; // calendar_queue
+
+} // namespace circ
+
+#endif /* #ifndef CIRCULAR_QUEUE_CALENDAR_H__ */
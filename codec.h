@@ -0,0 +1,92 @@
+#pragma once
+#ifndef CIRCULAR_QUEUE_CODEC_H__
+#define CIRCULAR_QUEUE_CODEC_H__
+#include "cq.h"
+#if __has_include(<lz4.h>)
+#include <lz4.h>
+#define CIRC_HAVE_LZ4 1
+#endif
+
+namespace circ {
+
+// Block codecs for the compressed containers (see tiered.h). A codec is a stateless type with
+//     static size_t bound(size_t n);                                  // Most bytes encode() can produce for n elements.
+//     static size_t encode(const T *src, size_t n, uint8_t *dst);      // Returns the number of bytes written.
+//     static void decode(const uint8_t *src, size_t nbytes, T *dst, size_t n);
+
+// LEB128 varints: 7 bits per byte, least significant first, high bit set on all but the last byte.
+static inline uint8_t *put_varint(uint8_t *dst, uint64_t v) {
+    for(; v >= 0x80; v >>= 7) *dst++ = uint8_t(v) | 0x80;
+    *dst++ = uint8_t(v);
+    return dst;
+}
+static inline const uint8_t *get_varint(const uint8_t *src, uint64_t &v) {
+    uint64_t ret = *src & 0x7f;
+    for(unsigned shift = 7; *src++ & 0x80; shift += 7) ret |= uint64_t(*src & 0x7f) << shift;
+    v = ret;
+    return src;
+}
+// Map signed values to unsigned so that small magnitudes of either sign get short varints.
+static inline uint64_t zigzag_encode(uint64_t v) {return (v << 1) ^ uint64_t(-(v >> 63));}
+static inline uint64_t zigzag_decode(uint64_t v) {return (v >> 1) ^ uint64_t(-(v & 1));}
+
+template<typename T>
+struct delta_varint_codec {
+    // Integers as zigzagged differences from their predecessor: timestamps, sequence numbers, ids.
+    // Slowly varying data takes one or two bytes per element.
+    static_assert(std::is_integral<T>::value, "delta_varint_codec encodes integers");
+    static size_t bound(size_t n) {return n * 10;}
+    static size_t encode(const T *src, size_t n, uint8_t *dst) {
+        uint8_t *p = dst;
+        uint64_t prev = 0;
+        for(size_t i = 0; i < n; ++i) {
+            const uint64_t cur = uint64_t(src[i]);
+            p = put_varint(p, zigzag_encode(cur - prev));
+            prev = cur;
+        }
+        return p - dst;
+    }
+    static void decode(const uint8_t *src, size_t, T *dst, size_t n) {
+        uint64_t prev = 0, d;
+        for(size_t i = 0; i < n; ++i) {
+            src = get_varint(src, d);
+            dst[i] = T(prev += zigzag_decode(d));
+        }
+    }
+};
+
+template<typename T>
+struct raw_codec {
+    // No compression; for measuring the others against.
+    static_assert(std::is_trivially_copyable<T>::value, "Codecs store elements as bytes");
+    static size_t bound(size_t n) {return n * sizeof(T);}
+    static size_t encode(const T *src, size_t n, uint8_t *dst) {
+        std::memcpy(dst, static_cast<const void *>(src), n * sizeof(T));
+        return n * sizeof(T);
+    }
+    static void decode(const uint8_t *src, size_t, T *dst, size_t n) {
+        std::memcpy(static_cast<void *>(dst), src, n * sizeof(T));
+    }
+};
+
+#ifdef CIRC_HAVE_LZ4
+template<typename T>
+struct lz4_codec {
+    // General-purpose byte compression for any trivially copyable T. Link with -llz4.
+    static_assert(std::is_trivially_copyable<T>::value, "Codecs store elements as bytes");
+    static size_t bound(size_t n) {return LZ4_compressBound(int(n * sizeof(T)));}
+    static size_t encode(const T *src, size_t n, uint8_t *dst) {
+        const int ret = LZ4_compress_default(reinterpret_cast<const char *>(src), reinterpret_cast<char *>(dst), int(n * sizeof(T)), int(bound(n)));
+        if(__builtin_expect(ret <= 0, 0)) throw std::runtime_error("LZ4 compression failed. Abort!");
+        return ret;
+    }
+    static void decode(const uint8_t *src, size_t nbytes, T *dst, size_t n) {
+        if(LZ4_decompress_safe(reinterpret_cast<const char *>(src), reinterpret_cast<char *>(dst), int(nbytes), int(n * sizeof(T))) != int(n * sizeof(T)))
+            throw std::runtime_error("Corrupt LZ4 block. Abort!");
+    }
+};
+#endif
+
+} // namespace circ
+
+#endif /* #ifndef CIRCULAR_QUEUE_CODEC_H__ */
@@ -0,0 +1,188 @@
+#pragma once
+#ifndef CIRCULAR_QUEUE_COMPACT_H__
+#define CIRCULAR_QUEUE_COMPACT_H__
+#include "cq.h"
+#include <ratio>       // For std::ratio
+
+namespace circ {
+
+template<typename T, typename SizeType=uint32_t, typename Growth=std::ratio<3, 2>, typename Allocator=malloc_allocator>
+class compact_deque: private Allocator {
+    // A circular queue with an arbitrary capacity.
+    // deque rounds its buffer up to a power of two, which nearly doubles memory for sizes
+    // just past one (1025 elements -> 2048 slots). Here the buffer is exactly as large as asked,
+    // and grows by Growth (1.5x by default) instead of 2x.
+    // Indices wrap by conditional subtraction: every offset we add is below capacity, so
+    // one compare and subtract replaces the mask and no modulus is ever needed.
+    // Capacity must stay below half the range of SizeType so start_ + size_ cannot overflow.
+    // Choose this or deque at compile time; deque remains the faster default.
+    static_assert(std::is_unsigned<SizeType>::value, "Must be unsigned");
+    static_assert(Growth::num > Growth::den, "Growth factor must be greater than 1");
+    SizeType  cap_;
+    SizeType start_;
+    SizeType  size_;
+    T        *data_;
+
+    SizeType wrap(SizeType i) const {return i >= cap_ ? i - cap_: i;}
+    void relocate_to(SizeType new_cap) {
+        CIRC_CONSTIF(std::is_trivially_copyable<T>::value) {
+            // realloc can often extend in place or remap pages instead of copying.
+            if(new_cap > cap_) {
+                T *tmp = static_cast<T *>(this->reallocate(data_, size_t(cap_) * sizeof(T), size_t(new_cap) * sizeof(T)));
+                if(tmp == nullptr) throw std::bad_alloc();
+                data_ = tmp;
+                if(size_ > SizeType(cap_ - start_)) {
+                    // Wrapped: slide the front segment to the end of the new buffer.
+                    const SizeType n = cap_ - start_;
+                    std::memmove(static_cast<void *>(data_ + (new_cap - n)), data_ + start_, size_t(n) * sizeof(T));
+                    start_ = new_cap - n;
+                }
+                cap_ = new_cap;
+                return;
+            }
+        }
+        T *tmp = static_cast<T *>(this->allocate(size_t(new_cap) * sizeof(T)));
+        if(tmp == nullptr) throw std::bad_alloc();
+        const SizeType first = std::min(size_, SizeType(cap_ - start_));
+        relocate(tmp, data_ + start_, first);
+        relocate(tmp + first, data_, size_ - first);
+        this->deallocate(data_, size_t(cap_) * sizeof(T));
+        data_ = tmp;
+        cap_ = new_cap;
+        start_ = 0;
+    }
+    static SizeType checked_capacity(uint64_t n) {
+        if(__builtin_expect(n >= (uint64_t(1) << (sizeof(SizeType) * CHAR_BIT - 1)), 0))
+            throw std::runtime_error("compact_deque capacity would overflow its size_type.");
+        return SizeType(n);
+    }
+    void grow() {
+        const uint64_t next = uint64_t(cap_) * Growth::num / Growth::den;
+        relocate_to(std::max(checked_capacity(next), SizeType(cap_ + 1)));
+    }
+
+public:
+    using size_type = SizeType;
+    using allocator_type = Allocator;
+    class iterator {
+        compact_deque *ref_;
+        SizeType       pos_; // Logical index from the front.
+    public:
+        iterator(compact_deque &ref, SizeType pos): ref_(&ref), pos_(pos) {}
+        T &operator*() const {return (*ref_)[pos_];}
+        T *operator->() const {return &(*ref_)[pos_];}
+        iterator &operator++() {++pos_; return *this;}
+        iterator operator++(int) {iterator copy(*this); ++pos_; return copy;}
+        std::ptrdiff_t operator-(const iterator &o) const {return std::ptrdiff_t(pos_) - std::ptrdiff_t(o.pos_);}
+        bool operator==(const iterator &o) const {return pos_ == o.pos_;}
+        bool operator!=(const iterator &o) const {return pos_ != o.pos_;}
+    };
+
+    compact_deque(SizeType size=3, const Allocator &alloc=Allocator()):
+        Allocator(alloc),
+        cap_(checked_capacity(std::max(size, SizeType(2)))), start_(0), size_(0),
+        data_(static_cast<T *>(this->allocate(size_t(cap_) * sizeof(T))))
+    {
+        if(data_ == nullptr) throw std::bad_alloc();
+    }
+    compact_deque(compact_deque &&other): Allocator(std::move(static_cast<Allocator &>(other))),
+        cap_(other.cap_), start_(other.start_), size_(other.size_), data_(other.data_)
+    {
+        other.cap_ = other.start_ = other.size_ = 0;
+        other.data_ = nullptr;
+    }
+    compact_deque(const compact_deque &other): compact_deque(other.cap_, other.get_allocator()) {
+        for(SizeType i = 0; i < other.size_; push_back(other[i++]));
+    }
+    compact_deque &operator=(const compact_deque &) = delete;
+    ~compact_deque() {
+        clear();
+        this->deallocate(data_, size_t(cap_) * sizeof(T));
+    }
+    allocator_type get_allocator() const {return static_cast<const Allocator &>(*this);}
+    iterator begin() {return iterator(*this, 0);}
+    iterator end()   {return iterator(*this, size_);}
+    // Guarantee room for n elements without further allocation.
+    void reserve(size_type n) {
+        if(n > cap_) relocate_to(checked_capacity(n));
+    }
+    template<typename... Args>
+    T &push_back(Args &&... args) {
+        if(__builtin_expect(size_ == cap_, 0)) grow();
+        T *ret = new(data_ + wrap(start_ + size_)) T(std::forward<Args>(args)...);
+        ++size_;
+        return *ret;
+    }
+    template<typename... Args>
+    T &push_front(Args &&... args) {
+        if(__builtin_expect(size_ == cap_, 0)) grow();
+        start_ = (start_ ? start_: cap_) - 1;
+        ++size_;
+        return *(new(data_ + start_) T(std::forward<Args>(args)...));
+    }
+    template<typename... Args>
+    T &emplace_back(Args &&... args) {
+        return push_back(std::forward<Args>(args)...); // Interface compatibility.
+    }
+    template<typename... Args>
+    T &emplace_front(Args &&... args) {
+        return push_front(std::forward<Args>(args)...); // Interface compatibility.
+    }
+    template<typename... Args>
+    T &push(Args &&... args) {
+        return push_back(std::forward<Args>(args)...); // Interface compatibility
+    }
+    T pop() {
+        if(__builtin_expect(size_ == 0, 0)) throw std::runtime_error("Popping item from empty buffer. Abort!");
+        T ret(std::move(data_[start_]));
+        data_[start_].~T();
+        start_ = wrap(start_ + 1);
+        --size_;
+        return ret;
+    }
+    T pop_front() {
+        return pop(); // Interface compatibility with std::list.
+    }
+    T pop_back() {
+        if(__builtin_expect(size_ == 0, 0)) throw std::runtime_error("Popping item from empty buffer. Abort!");
+        T &slot = data_[wrap(start_ + --size_)];
+        T ret(std::move(slot));
+        slot.~T();
+        return ret;
+    }
+    T &operator[](size_type i) {return data_[wrap(start_ + i)];}
+    const T &operator[](size_type i) const {return data_[wrap(start_ + i)];}
+    T &front() {return data_[start_];}
+    const T &front() const {return data_[start_];}
+    T &back() {return (*this)[size_ - 1];}
+    const T &back() const {return (*this)[size_ - 1];}
+    template<typename Functor>
+    void for_each(const Functor &func) {
+        const SizeType first = std::min(size_, SizeType(cap_ - start_));
+        for(T *p = data_ + start_, *e = p + first; p != e; func(*p++));
+        for(T *p = data_, *e = p + (size_ - first); p != e; func(*p++));
+    }
+    template<typename Functor>
+    void for_each(const Functor &func) const {
+        const_cast<compact_deque *>(this)->for_each([&func](const T &x) {func(x);});
+    }
+    std::vector<T> to_vector() const {
+        std::vector<T> ret;
+        ret.reserve(size_);
+        for_each([&ret](const T &x) {ret.push_back(x);});
+        return ret;
+    }
+    void clear() {
+        for_each([](T &x) {x.~T();});
+        start_ = size_ = 0;
+    }
+    size_type capacity() const noexcept {return cap_;}
+    size_type size()     const noexcept {return size_;}
+    bool empty()         const noexcept {return size_ == 0;}
+    auto data() const {return data_;}
+    auto data()       {return data_;}
+}; // compact_deque
+
+} // namespace circ
+
+#endif /* #ifndef CIRCULAR_QUEUE_COMPACT_H__ */
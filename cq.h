@@ -11,8 +11,14 @@
 #include <cstring>     // For std::memcpy
 #include <vector>      // For converting to vector
 #include <climits>     // CHAR_BIT
+#include <limits>      // For std::numeric_limits
 #include <iostream>
 #include <algorithm>
+#include <iterator>    // For std::distance
+#include <chrono>      // For timing resizes in op_stats
+#if defined(__AVX512F__)
+#include <immintrin.h> // For compress-store in erase_if
+#endif
 
 namespace circ {
 using std::size_t;
@@ -27,7 +33,55 @@ using std::uint8_t;
 #define CIRC_CONSTIF if
 #endif
 
-template<typename T, typename SizeType=uint32_t>
+#ifndef CIRC_CACHELINE_SIZE
+#define CIRC_CACHELINE_SIZE 64
+#endif
+
+struct malloc_allocator {
+    // Default storage policy for deque. Policies hand out raw, uninitialized bytes;
+    // reallocate must preserve the first min(old_bytes, new_bytes) bytes, as realloc does.
+    // Deallocate may be passed nullptr.
+    void *allocate(size_t nbytes) {return std::malloc(nbytes);}
+    void *reallocate(void *ptr, size_t, size_t new_bytes) {return std::realloc(ptr, new_bytes);}
+    void deallocate(void *ptr, size_t) {std::free(ptr);}
+};
+
+struct no_stats {
+    // Default instrumentation policy for deque: every hook is empty and inlines away.
+    void on_push(size_t) {}
+    void on_pop(size_t) {}
+    uint64_t resize_begin() const {return 0;}
+    void on_resize(size_t, size_t, size_t, uint64_t) {}
+};
+
+struct op_stats {
+    // Instrumentation policy counting what a deque does: circ::deque<T, uint32_t, circ::malloc_allocator, circ::op_stats>.
+    // Read it back with deque::stats(); it is a plain struct, so copying it is a snapshot.
+    uint64_t pushes = 0;
+    uint64_t pops = 0;
+    uint64_t resizes = 0;
+    uint64_t bytes_relocated = 0; // Includes bytes realloc may have copied.
+    uint64_t high_water = 0;      // Largest size() seen.
+    uint64_t resize_ns = 0;
+    uint64_t occupancy[64] = {};  // occupancy[i]: pushes after which size() was in [2^i, 2^(i + 1)).
+    void on_push(size_t size) {
+        ++pushes;
+        high_water = std::max(high_water, uint64_t(size));
+        if(size) ++occupancy[63 - __builtin_clzll(size)]; // commit_back(0) on an empty deque reports 0.
+    }
+    void on_pop(size_t) {++pops;}
+    uint64_t resize_begin() const {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+    void on_resize(size_t, size_t, size_t bytes, uint64_t start) {
+        ++resizes;
+        bytes_relocated += bytes;
+        resize_ns += resize_begin() - start;
+    }
+    void reset() {*this = op_stats();}
+};
+
+template<typename T, typename SizeType=uint32_t, typename Allocator=malloc_allocator, typename Stats=no_stats>
 class deque;
 
 
@@ -41,11 +95,72 @@ static inline T roundup(T x) {
     return ++x;
 }
 
-template<typename T, typename SizeType>
+template<typename T>
+static inline void relocate(T *dst, T *src, size_t n) {
+    // Moves n objects into uninitialized memory at dst, ending their lifetimes at src.
+    CIRC_CONSTIF(std::is_trivially_copyable<T>::value) {
+        std::memcpy(static_cast<void *>(dst), static_cast<const void *>(src), n * sizeof(T));
+    } else {
+        for(size_t i = 0; i < n; ++i) {
+            new(dst + i) T(std::move(src[i]));
+            src[i].~T();
+        }
+    }
+}
+
+template<typename T>
+static inline void relocate_overlapping(T *dst, T *src, size_t n) {
+    // As relocate, but the ranges may overlap, as with memmove.
+    CIRC_CONSTIF(std::is_trivially_copyable<T>::value) {
+        std::memmove(static_cast<void *>(dst), static_cast<const void *>(src), n * sizeof(T));
+    } else if(dst < src) {
+        for(size_t i = 0; i < n; ++i) {
+            new(dst + i) T(std::move(src[i]));
+            src[i].~T();
+        }
+    } else {
+        for(size_t i = n; i--;) {
+            new(dst + i) T(std::move(src[i]));
+            src[i].~T();
+        }
+    }
+}
+
+template<typename T>
+class aligned_array {
+    // A fixed-size array of default-constructed T honouring alignof(T), for cache-line padded slots:
+    // new T[n] only respects alignments beyond alignof(std::max_align_t) from C++17 on.
+    void  *raw_;
+    T     *data_;
+    size_t n_;
+public:
+    explicit aligned_array(size_t n): raw_(std::malloc(n * sizeof(T) + alignof(T))), n_(0) {
+        if(raw_ == nullptr) throw std::bad_alloc();
+        data_ = reinterpret_cast<T *>((reinterpret_cast<uintptr_t>(raw_) + alignof(T) - 1) & ~uintptr_t(alignof(T) - 1));
+        try {
+            for(; n_ < n; ++n_) new(data_ + n_) T();
+        } catch(...) {
+            while(n_) data_[--n_].~T();
+            std::free(raw_);
+            throw;
+        }
+    }
+    aligned_array(const aligned_array &) = delete;
+    aligned_array &operator=(const aligned_array &) = delete;
+    ~aligned_array() {
+        while(n_) data_[--n_].~T();
+        std::free(raw_);
+    }
+    T &operator[](size_t i) {return data_[i];}
+    const T &operator[](size_t i) const {return data_[i];}
+    size_t size() const noexcept {return n_;}
+}; // aligned_array
+
+template<typename T, typename SizeType, typename Allocator, typename Stats>
 class circular_iterator {
     using size_type = SizeType;
     // TODO: increment by an integral quantity.
-    using deque_type = deque<T, SizeType>;
+    using deque_type = deque<T, SizeType, Allocator, Stats>;
     deque_type *ref_;
     deque_type &ref() {return *ref_;}
     const deque_type &ref() const {return *ref_;}
@@ -84,6 +199,7 @@ public:
         pos_ &= ref().mask();
         return *this;
     }
+    SizeType pos() const noexcept {return pos_;} // Index into data().
     T &operator*() {
         return ref().data()[pos_];
     }
@@ -125,10 +241,10 @@ public:
         return pos_ >= other.pos_;
     }
 };
-template<typename T, typename SizeType>
+template<typename T, typename SizeType, typename Allocator, typename Stats>
 class const_circular_iterator {
     using size_type = SizeType;
-    using deque_type = deque<T, SizeType>;
+    using deque_type = deque<T, SizeType, Allocator, Stats>;
     const deque_type *ref_;
     SizeType          pos_;
     auto &ref() {return *ref_;}
@@ -166,6 +282,7 @@ public:
         pos_ &= ref().mask();
         return *this;
     }
+    SizeType pos() const noexcept {return pos_;} // Index into data().
     const T &operator*() const noexcept {
         return ref().data()[pos_];
     }
@@ -199,46 +316,192 @@ public:
     }
 };
 
-template<typename T, typename SizeType>
-class deque {
+template<typename T, typename SizeType, typename Allocator, typename Stats>
+class deque: private Allocator, private Stats {
     // A circular queue in which extra memory has been allocated up to a power of two.
     // This allows us to use bitmasks instead of modulus operations.
     // This circular queue is NOT threadsafe. Its purpose is creating a double-ended queue without
     // the overhead of a doubly-linked list.
+    // Memory comes from Allocator (see malloc_allocator); stateless policies take no space.
+    // Stats receives a callback for each push, pop and resize (see no_stats and op_stats).
     SizeType  mask_;
     SizeType start_;
     SizeType  stop_;
     T        *data_;
+    SizeType  shrink_floor_; // 0 disables automatic shrinking.
     static_assert(std::is_unsigned<SizeType>::value, "Must be unsigned");
 
+    void relocate_to(SizeType new_size) {
+        // Move the (up to two) occupied segments to the front of a fresh buffer of new_size slots.
+        assert(new_size > size() && (new_size & (new_size - 1)) == 0);
+        const uint64_t timer = this->resize_begin();
+        T *tmp = static_cast<T *>(this->allocate(size_t(new_size) * sizeof(T)));
+        if(tmp == nullptr) throw std::bad_alloc();
+        const size_type n = size();
+        if(stop_ < start_) {
+            const size_type first = mask_ + 1 - start_;
+            relocate(tmp, data_ + start_, first);
+            relocate(tmp + first, data_, stop_);
+        } else relocate(tmp, data_ + start_, n);
+        this->deallocate(data_, (size_t(mask_) + 1) * sizeof(T));
+        data_ = tmp;
+        start_ = 0;
+        stop_ = n;
+        this->on_resize(size_t(mask_) + 1, new_size, size_t(n) * sizeof(T), timer);
+        mask_ = new_size - 1;
+    }
+    void maybe_shrink() {
+        // Halve once occupancy drops below a quarter. Afterwards the queue is under half full,
+        // so it has to double before growing again: the gap between the two thresholds is the hysteresis.
+        // Shrinking is optional, so a failed allocation keeps the current buffer instead of failing the pop
+        // that triggered it: relocate_to allocates before it moves anything.
+        const size_type cap = mask_ + 1;
+        if(size() < (cap >> 2) && (cap >> 1) >= std::max(shrink_floor_, size_type(4))) {
+            try {
+                relocate_to(cap >> 1);
+            } catch(const std::bad_alloc &) {}
+        }
+    }
+    void ring_relocate(SizeType dst, SizeType src, SizeType n) {
+        // Relocate n elements from slot src to slot dst, both runs possibly wrapping and overlapping,
+        // as a few relocate_overlapping calls on contiguous pieces. Pieces are taken from the end
+        // nearer the destination, so nothing is overwritten before it has moved.
+        if(dst == src) return;
+        const size_t cap = size_t(mask_) + 1;
+        if(((src - dst) & mask_) < ((dst - src) & mask_)) { // Moving towards the front.
+            while(n) {
+                const size_type k = size_type(std::min({size_t(n), cap - src, cap - dst}));
+                relocate_overlapping(data_ + dst, data_ + src, k);
+                src = (src + k) & mask_, dst = (dst + k) & mask_, n -= k;
+            }
+        } else {
+            src = (src + n) & mask_, dst = (dst + n) & mask_;
+            while(n) {
+                const size_type k = size_type(std::min({size_t(n), src ? size_t(src): cap, dst ? size_t(dst): cap}));
+                src = (src - k) & mask_, dst = (dst - k) & mask_, n -= k;
+                relocate_overlapping(data_ + dst, data_ + src, k);
+            }
+        }
+    }
+    template<typename Pred>
+    SizeType compact(T *src, size_t n, SizeType w, const Pred &pred) {
+        // erase_if on the contiguous run src[0, n): survivors are moved to the slots from w, which never
+        // runs ahead of src. Returns the next free slot.
+        CIRC_CONSTIF(std::is_trivially_copyable<T>::value) {
+            size_t k = 0;
+#if defined(__AVX512F__)
+            CIRC_CONSTIF(sizeof(T) == 4 || sizeof(T) == 8) {
+                // Gather a block's verdicts in a mask, then write its survivors with one compress-store,
+                // whenever the store cannot wrap around the end of the buffer.
+                constexpr unsigned lanes = 64 / sizeof(T);
+                for(const size_t cap = size_t(mask_) + 1; k + lanes <= n && w + lanes <= cap; k += lanes) {
+                    unsigned keep = 0;
+                    for(unsigned j = 0; j < lanes; ++j) keep |= unsigned(!pred(src[k + j])) << j;
+                    const __m512i v = _mm512_loadu_si512(static_cast<const void *>(src + k));
+                    CIRC_CONSTIF(sizeof(T) == 4) _mm512_mask_compressstoreu_epi32(static_cast<void *>(data_ + w), __mmask16(keep), v);
+                    else _mm512_mask_compressstoreu_epi64(static_cast<void *>(data_ + w), __mmask8(keep), v);
+                    w = (w + __builtin_popcount(keep)) & mask_;
+                }
+            }
+#endif
+            // Branch-free: store every element, but only advance past survivors.
+            for(; k < n; ++k) {
+                const bool keep = !pred(src[k]);
+                std::memmove(static_cast<void *>(data_ + w), static_cast<const void *>(src + k), sizeof(T));
+                w = (w + keep) & mask_;
+            }
+        } else {
+            for(size_t k = 0; k < n; ++k) {
+                if(pred(src[k])) {
+                    src[k].~T();
+                    continue;
+                }
+                if(data_ + w != src + k) relocate(data_ + w, src + k, 1);
+                w = (w + 1) & mask_;
+            }
+        }
+        return w;
+    }
+    SizeType open_gap(SizeType i, SizeType n) {
+        // Make n uninitialized slots before the ith element by moving whichever side is shorter.
+        // Returns the slot of the first one.
+        const size_type sz = size();
+        if(__builtin_expect(size_t(sz) + n > capacity(), 0)) {
+            if(__builtin_expect(size_t(sz) + n > size_t(std::numeric_limits<size_type>::max() / 2), 0)) throw std::bad_alloc();
+            reserve(sz + n);
+        }
+        if(i < sz - i) {
+            const size_type old = start_;
+            start_ = (start_ - n) & mask_;
+            ring_relocate(start_, old, i);
+        } else {
+            const size_type at = (start_ + i) & mask_;
+            ring_relocate((at + n) & mask_, at, sz - i);
+            stop_ = (stop_ + n) & mask_;
+        }
+        return (start_ + i) & mask_;
+    }
+    void close_gap(SizeType i, SizeType n) {
+        // Undo open_gap(i, n): remove the n uninitialized slots before the ith element.
+        const size_type sz = size() - n;
+        if(i < sz - i) {
+            ring_relocate((start_ + n) & mask_, start_, i);
+            start_ = (start_ + n) & mask_;
+        } else {
+            const size_type at = (start_ + i) & mask_;
+            ring_relocate(at, (at + n) & mask_, sz - i);
+            stop_ = (stop_ - n) & mask_;
+        }
+    }
+
 public:
+    using value_type = T;
     using size_type = SizeType;
-    using iterator = circular_iterator<T, size_type>;
-    using const_iterator = const_circular_iterator<T, size_type>;
-    deque(SizeType size=3):
+    using allocator_type = Allocator;
+    using stats_type = Stats;
+    using iterator = circular_iterator<T, size_type, Allocator, Stats>;
+    using const_iterator = const_circular_iterator<T, size_type, Allocator, Stats>;
+    deque(SizeType size=3, const Allocator &alloc=Allocator()):
+            Allocator(alloc),
             mask_(roundup(size + 1) - 1),
             start_(0), stop_(0),
-            data_(static_cast<T *>(std::malloc((mask_ + 1) * sizeof(T))))
+            data_(static_cast<T *>(this->allocate((size_t(mask_) + 1) * sizeof(T)))),
+            shrink_floor_(0)
     {
         assert((mask_ & (mask_ + 1)) == 0);
         if(data_ == nullptr) {
             throw std::bad_alloc();
         }
     }
-    deque(deque &&other) {
-        if(&other == this) return;
-        std::memcpy(this, &other, sizeof(*this));
-        std::memset(&other, 0, sizeof(other));
+    // Moving takes the buffer and leaves other empty but usable: it keeps a copy of its allocator,
+    // so a stateful policy still allocates as configured when other grows again.
+    deque(deque &&other):
+            Allocator(static_cast<const Allocator &>(other)), Stats(static_cast<const Stats &>(other)),
+            mask_(other.mask_), start_(other.start_), stop_(other.stop_), data_(other.data_), shrink_floor_(other.shrink_floor_)
+    {
+        other.release();
     }
-    deque(const deque &other) {
+    deque(const deque &other): Allocator(other.get_allocator()) {
         if(&other == this) return;
         start_ = other.start_;
         stop_  = other.stop_;
         mask_  = other.mask_;
-        auto tmp = static_cast<T *>(std::malloc(sizeof(T) * (mask_ + 1)));
+        shrink_floor_ = other.shrink_floor_;
+        auto tmp = static_cast<T *>(this->allocate(sizeof(T) * (size_t(mask_) + 1)));
         if(__builtin_expect(tmp == nullptr, 0)) throw std::bad_alloc();
         data_ = tmp;
-        for(auto i(other.start_); i != other.stop_; data_[i] = other.data_[i], i = (i+1) & mask_);
+        for(auto i(other.start_); i != other.stop_; new(data_ + i) T(other.data_[i]), i = (i+1) & mask_);
+    }
+    deque &operator=(deque &&other) {
+        if(&other == this) return *this;
+        this->free(); // With our own allocator, before adopting other's.
+        static_cast<Allocator &>(*this) = static_cast<const Allocator &>(other);
+        static_cast<Stats &>(*this) = static_cast<const Stats &>(other);
+        mask_ = other.mask_, start_ = other.start_, stop_ = other.stop_;
+        data_ = other.data_;
+        shrink_floor_ = other.shrink_floor_;
+        other.release();
+        return *this;
     }
     iterator begin() noexcept {
         return iterator(*this, start_);
@@ -257,32 +520,31 @@ public:
     auto mask() const {return mask_;}
     auto data() const {return data_;}
     auto data()       {return data_;}
+    allocator_type get_allocator() const {return static_cast<const Allocator &>(*this);}
+    const stats_type &stats() const {return static_cast<const Stats &>(*this);}
+    stats_type &stats() {return static_cast<Stats &>(*this);}
     void resize(size_type new_size) {
-        // TODO: this will cause a leak if the later malloc fails.
-        // Fix this by only copying the temporary buffer to data_ in case of success in all allocations.
         if(__builtin_expect(new_size < mask_, 0)) throw std::runtime_error("Attempting to resize to value smaller than queue's size, either from user error or overflowing the size_type. Abort!");
         new_size = roundup(new_size); // Is this necessary? We can hide resize from the user and then cut out this call.
         new_size = std::max(size_type(4), new_size);
-        auto tmp = std::realloc(data_, new_size * sizeof(T));
+        CIRC_CONSTIF(!std::is_trivially_copyable<T>::value) {
+            // realloc would move objects bytewise, which breaks types that point into themselves.
+            if(new_size != mask_ + 1) relocate_to(new_size);
+            return;
+        }
+        const size_type old_size = mask_ + 1;
+        const uint64_t timer = this->resize_begin();
+        auto tmp = this->reallocate(data_, size_t(old_size) * sizeof(T), size_t(new_size) * sizeof(T));
         if(tmp == nullptr) throw std::bad_alloc();
         data_ = static_cast<T *>(tmp);
         if(start_ == stop_) {
-            if(start_) {
-                stop_ = mask_ + 1;
-                auto tmp = static_cast<T *>(std::malloc((stop_) * sizeof(T)));
-                if(tmp == nullptr) throw std::bad_alloc();
-                std::memcpy(tmp, data_ + start_, (stop_ - start_) * sizeof(T));
-                std::memcpy(tmp + (stop_ - start_), data_, stop_ * sizeof(T));
-                std::memcpy(data_, tmp, (stop_) * sizeof(T));
-                std::free(tmp);
-                start_ = 0;
-            }
-        } else if(stop_ < start_) {
-            auto tmp = size();
-            std::rotate(this->begin(), this->end(), iterator(*this, mask_));
-            start_ = 0;
-            stop_ = tmp;
+            start_ = stop_ = 0;
+        } else if(stop_ < start_ && new_size != old_size) {
+            // The wrapped prefix fits directly after the old end, as new_size >= 2 * old_size.
+            std::memcpy(static_cast<void *>(data_ + old_size), data_, stop_ * sizeof(T));
+            stop_ += old_size;
         }
+        this->on_resize(old_size, new_size, size_t(old_size + (stop_ >= old_size ? stop_ - old_size: 0)) * sizeof(T), timer);
         mask_ = new_size - 1;
     }
     // Does not yet implement push_front.
@@ -293,6 +555,7 @@ public:
         }
         size_type ind = stop_;
         ++stop_; stop_ &= mask_;
+        this->on_push(size());
         return *(new(data_ + ind) T(std::forward<Args>(args)...));
     }
     template<typename... Args>
@@ -302,7 +565,7 @@ public:
         }
         start_ = (start_ - 1) & mask_;
         assert(start_ <= mask_);
-        assert(start_ > 0);
+        this->on_push(size());
         return *(new(data_ + start_) T(std::forward<Args>(args)...));
     }
     template<typename... Args>
@@ -317,12 +580,16 @@ public:
         if(__builtin_expect(stop_ == start_, 0)) throw std::runtime_error("Popping item from empty buffer. Abort!");
         T ret(std::move(data_[start_++]));
         start_ &= mask_;
+        this->on_pop(size());
+        if(__builtin_expect(shrink_floor_ != 0, 0)) maybe_shrink();
         return ret; // If unused, the std::move causes it to leave scope and therefore be destroyed.
     }
     T pop_back() {
         if(__builtin_expect(stop_ == start_, 0)) throw std::runtime_error("Popping item from empty buffer. Abort!");
-        T ret(std::move(data_[--stop_]));
-        start_ &= mask_;
+        stop_ = (stop_ - 1) & mask_;
+        T ret(std::move(data_[stop_]));
+        this->on_pop(size());
+        if(__builtin_expect(shrink_floor_ != 0, 0)) maybe_shrink();
         return ret; // If unused, the std::move causes it to leave scope and therefore be destroyed.
     }
     T pop_front() {
@@ -347,9 +614,127 @@ public:
     T &front() {
         return data_[start_];
     }
+    T &operator[](size_type i) {
+        return data_[(start_ + i) & mask_];
+    }
+    const T &operator[](size_type i) const {
+        return data_[(start_ + i) & mask_];
+    }
     const T &front() const {
         return data_[start_];
     }
+    // Bulk access for trivially copyable data, e.g. I/O straight into the buffer (see fdio.h).
+    // Each fills ptrs/lens with the (up to two) contiguous runs, in queue order, and returns how many there are.
+    // free_segments covers the unused slots after back(); used_segments the elements from front().
+    unsigned free_segments(T **ptrs, size_type *lens) noexcept {
+        const size_type last = (start_ - 1) & mask_; // The one slot kept empty to tell full from empty.
+        if(stop_ == last) return 0;
+        if(stop_ < last) {
+            ptrs[0] = data_ + stop_, lens[0] = last - stop_;
+            return 1;
+        }
+        ptrs[0] = data_ + stop_, lens[0] = mask_ + 1 - stop_;
+        if(last == 0) return 1;
+        ptrs[1] = data_, lens[1] = last;
+        return 2;
+    }
+    unsigned used_segments(T **ptrs, size_type *lens) const noexcept {
+        if(stop_ == start_) return 0;
+        if(start_ < stop_) {
+            ptrs[0] = data_ + start_, lens[0] = stop_ - start_;
+            return 1;
+        }
+        ptrs[0] = data_ + start_, lens[0] = mask_ + 1 - start_;
+        if(stop_ == 0) return 1;
+        ptrs[1] = data_, lens[1] = stop_;
+        return 2;
+    }
+    // Append n elements already written into the free segments. Stats sees one push.
+    void commit_back(size_type n) {
+        static_assert(std::is_trivially_copyable<T>::value, "Bulk access requires trivially copyable types");
+        assert(n <= capacity() - size());
+        stop_ = (stop_ + n) & mask_;
+        this->on_push(size());
+    }
+    // Drop n elements from the front without running destructors. Stats sees one pop.
+    void discard_front(size_type n) {
+        static_assert(std::is_trivially_copyable<T>::value, "Bulk access requires trivially copyable types");
+        if(__builtin_expect(n > size(), 0)) throw std::runtime_error("Discarding more items than are in the buffer. Abort!");
+        start_ = (start_ + n) & mask_;
+        this->on_pop(size());
+        if(__builtin_expect(shrink_floor_ != 0, 0)) maybe_shrink();
+    }
+    // Removal and insertion in the middle move only the elements on the shorter side of the position,
+    // at most size() / 2 of them, with memmove for trivially copyable types. Iterators are invalidated.
+    iterator erase(iterator first, iterator last) {
+        const size_type i = (first.pos() - start_) & mask_, n = (last.pos() - first.pos()) & mask_;
+        const size_type sz = size();
+        assert(size_t(i) + n <= sz);
+        if(n == 0) return first;
+        CIRC_CONSTIF(!std::is_trivially_destructible<T>::value)
+            for(size_type j = 0; j < n; ++j) data_[(first.pos() + j) & mask_].~T();
+        if(i < sz - i - n) {
+            ring_relocate((start_ + n) & mask_, start_, i);
+            start_ = (start_ + n) & mask_;
+        } else {
+            ring_relocate(first.pos(), last.pos(), sz - i - n);
+            stop_ = (stop_ - n) & mask_;
+        }
+        this->on_pop(size());
+        if(__builtin_expect(shrink_floor_ != 0, 0)) maybe_shrink();
+        return iterator(*this, (start_ + i) & mask_);
+    }
+    iterator erase(iterator pos) {
+        return erase(pos, pos + 1);
+    }
+    // Returns an iterator to the new element.
+    template<typename... Args>
+    iterator emplace(iterator pos, Args &&... args) {
+        T tmp(std::forward<Args>(args)...); // Built first, so a throwing constructor leaves the deque intact.
+        const size_type at = open_gap((pos.pos() - start_) & mask_, 1);
+        new(data_ + at) T(std::move(tmp));
+        this->on_push(size());
+        return iterator(*this, at);
+    }
+    iterator insert(iterator pos, const T &value) {return emplace(pos, value);}
+    iterator insert(iterator pos, T &&value) {return emplace(pos, std::move(value));}
+    // Inserts [first, last) before pos; returns an iterator to the first element inserted.
+    // The range may not come from this deque. If a copy throws, the deque is left as it was.
+    template<typename ForwardIt, typename=typename std::iterator_traits<ForwardIt>::iterator_category>
+    iterator insert(iterator pos, ForwardIt first, ForwardIt last) {
+        const size_type n = size_type(std::distance(first, last));
+        if(n == 0) return pos;
+        const size_type i = (pos.pos() - start_) & mask_, at = open_gap(i, n);
+        size_type j = 0;
+        try {
+            for(; j < n; ++j, ++first) new(data_ + ((at + j) & mask_)) T(*first);
+        } catch(...) {
+            while(j) data_[(at + --j) & mask_].~T();
+            close_gap(i, n);
+            throw;
+        }
+        this->on_push(size());
+        return iterator(*this, at);
+    }
+    // Removes every element for which pred(element) is true in one stable pass over the (up to two)
+    // contiguous runs, without allocating. Returns the number removed.
+    template<typename Pred>
+    size_type erase_if(const Pred &pred) {
+        const size_type sz = size();
+        size_type i = 0, r = start_;
+        for(; i < sz && !pred(data_[r]); ++i, r = (r + 1) & mask_); // Survivors before the first removal stay put.
+        if(i == sz) return 0;
+        data_[r].~T(); // pred has already condemned it; compact starts after it, so pred runs once per element.
+        const size_type next = (r + 1) & mask_;
+        const size_t rest = sz - i - 1, first = std::min(rest, size_t(mask_) + 1 - next);
+        size_type w = compact(data_ + next, first, r, pred);
+        if(first < rest) w = compact(data_, rest - first, w, pred);
+        stop_ = w;
+        this->on_pop(size());
+        const size_type removed = sz - size();
+        if(__builtin_expect(shrink_floor_ != 0, 0)) maybe_shrink();
+        return removed;
+    }
     template<typename Functor>
     void for_each(const Functor &func) {
         for(SizeType i = start_; i != stop_; func(data_[i++]), i &= mask_);
@@ -364,6 +749,18 @@ public:
     }
     ~deque() {this->free();}
     size_type capacity() const noexcept {return mask_;}
+    // Make room for n elements now, so that the next n pushes never resize.
+    void reserve(size_type n) {
+        if(n > mask_) resize(n + 1);
+    }
+    // Release memory beyond the smallest power of two which holds the current contents.
+    void shrink_to_fit() {
+        const size_type target = std::max(size_type(4), roundup(size_type(size() + 1)));
+        if(target <= mask_) relocate_to(target);
+    }
+    // Shrink automatically as elements are popped, never below floor slots. 0 turns this off.
+    void auto_shrink(size_type floor) {shrink_floor_ = floor;}
+    size_type auto_shrink() const noexcept {return shrink_floor_;}
     size_type size()     const noexcept {return (stop_ - start_) & mask_;}
     std::vector<T> to_vector() const {
         std::vector<T> ret;
@@ -378,7 +775,15 @@ public:
     }
     void free() {
         clear();
-        std::free(data_);
+        this->deallocate(data_, (size_t(mask_) + 1) * sizeof(T));
+    }
+private:
+    void release() noexcept {
+        // Forget the buffer after it was moved elsewhere. The next push allocates afresh.
+        static_cast<Stats &>(*this) = Stats();
+        mask_ = start_ = stop_ = 0;
+        data_ = nullptr;
+        shrink_floor_ = 0;
     }
 }; // deque
 
@@ -394,8 +799,8 @@ public:
 
 } // namespace circ
 namespace std {
-template<typename T, typename SizeType>
-struct iterator_traits<circ::circular_iterator<T, SizeType>> {
+template<typename T, typename SizeType, typename Allocator, typename Stats>
+struct iterator_traits<circ::circular_iterator<T, SizeType, Allocator, Stats>> {
     using difference_type = std::ptrdiff_t;
     using reference_type = T &;
     using pointer        = T *;
@@ -403,8 +808,8 @@ struct iterator_traits<circ::circular_iterator<T, SizeType>> {
     struct iterator_category: public forward_iterator_tag {};
 };
 
-template<typename T, typename SizeType>
-struct iterator_traits<circ::const_circular_iterator<T, SizeType>> {
+template<typename T, typename SizeType, typename Allocator, typename Stats>
+struct iterator_traits<circ::const_circular_iterator<T, SizeType, Allocator, Stats>> {
     using difference_type = std::ptrdiff_t;
     using reference_type = T &;
     using pointer        = T *;
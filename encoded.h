@@ -0,0 +1,174 @@
+#pragma once
+#ifndef CIRCULAR_QUEUE_ENCODED_H__
+#define CIRCULAR_QUEUE_ENCODED_H__
+#include "cq.h"
+
+namespace circ {
+
+template<typename T, unsigned BlockSize=128, typename SizeType=uint32_t>
+class delta_deque {
+    // A FIFO of non-decreasing integers (timestamps, sequence numbers, offsets) stored as bit-packed deltas.
+    // The newest values sit uncompressed in tail_. Every BlockSize pushes, tail_ becomes a block:
+    // an anchor (its first value), and the BlockSize - 1 gaps between consecutive values packed at the
+    // bit width of the largest gap, into words_. A steady 1 ms clock in ns takes ~20 bits per value
+    // instead of 64; a sequence number with stride 1 takes one bit.
+    // Every element of a block has the same width, so decoding is a branch-free unpack and a
+    // prefix sum which the compiler vectorizes, unlike varints. Anchors give random access by block:
+    // operator[] decodes one block, and lower_bound binary searches anchors before decoding one.
+    // The front block is decoded once into head_ as pop reaches it.
+    static_assert(std::is_integral<T>::value, "delta_deque stores integers");
+    static_assert(BlockSize >= 2, "Blocks must hold at least two values");
+    using U = typename std::make_unsigned<T>::type;
+    static constexpr unsigned ngaps = BlockSize - 1;
+    struct block {
+        T        anchor;
+        T        last;
+        uint64_t word_seq; // Sequence number of the block's first word in words_, counting popped words.
+        unsigned width;    // Bits per gap, 0-64.
+        unsigned nwords() const {return (ngaps * width + 63) / 64;}
+    };
+    deque<block, SizeType>    blocks_;
+    deque<uint64_t, SizeType> words_;
+    uint64_t                  words_popped_;
+    deque<T, SizeType>        tail_;   // Newest values, fewer than BlockSize.
+    T                         head_[BlockSize];
+    bool                      head_valid_;
+    unsigned                  front_pos_; // Values already popped from blocks_.front().
+
+    void encode() {
+        T v[BlockSize];
+        for(unsigned i = 0; i < BlockSize; v[i] = tail_[i], ++i);
+        U maxgap = 0;
+        for(unsigned i = 0; i < ngaps; ++i) maxgap |= U(U(v[i + 1]) - U(v[i]));
+        block b{v[0], v[ngaps], words_popped_ + words_.size(), maxgap ? 64 - unsigned(__builtin_clzll(uint64_t(maxgap))): 0u};
+        const unsigned nw = b.nwords();
+        uint64_t w[(ngaps * 64 + 63) / 64 + 1] = {};
+        for(unsigned i = 0; i < ngaps; ++i) {
+            const uint64_t gap = uint64_t(U(U(v[i + 1]) - U(v[i])));
+            const unsigned off = i * b.width, sh = off & 63;
+            w[off >> 6] |= gap << sh;
+            w[(off >> 6) + 1] |= (gap >> 1) >> (63 - sh); // Bits spilling into the next word; 0 if none.
+        }
+        for(unsigned i = 0; i < nw; words_.push_back(w[i++]));
+        blocks_.push_back(b);
+        tail_.clear();
+    }
+    void decode(SizeType bi, T *out) const {
+        const block &b = blocks_[bi];
+        uint64_t w[(ngaps * 64 + 63) / 64 + 1] = {}; // Zeroed: a width-0 block has no words, but the unpack still reads w[1].
+        const unsigned nw = b.nwords();
+        const SizeType base = SizeType(b.word_seq - words_popped_);
+        for(unsigned i = 0; i < nw; ++i) w[i] = words_[base + i];
+        w[nw] = 0;
+        const uint64_t mask = b.width == 64 ? ~uint64_t(0): (uint64_t(1) << b.width) - 1;
+        U gaps[ngaps];
+        for(unsigned i = 0; i < ngaps; ++i) {
+            const unsigned off = i * b.width, sh = off & 63;
+            gaps[i] = U(((w[off >> 6] >> sh) | ((w[(off >> 6) + 1] << 1) << (63 - sh))) & mask);
+        }
+        U acc = U(b.anchor);
+        out[0] = b.anchor;
+        for(unsigned i = 0; i < ngaps; ++i) out[i + 1] = T(acc += gaps[i]);
+    }
+    void load_head() {
+        if(!head_valid_) decode(0, head_), head_valid_ = true;
+    }
+
+public:
+    using size_type = SizeType;
+    using value_type = T;
+    delta_deque(): blocks_(3), words_(3), words_popped_(0), tail_(BlockSize), head_valid_(false), front_pos_(0) {}
+    void push_back(T x) {
+        if(__builtin_expect(!empty() && x < back(), 0)) throw std::runtime_error("delta_deque values must be non-decreasing. Abort!");
+        tail_.push_back(x);
+        if(__builtin_expect(tail_.size() == BlockSize, 0)) encode();
+    }
+    void push(T x) {
+        push_back(x); // Interface compatibility
+    }
+    T pop() {
+        if(blocks_.size() == 0) return tail_.pop();
+        load_head();
+        const T ret = head_[front_pos_];
+        if(++front_pos_ == BlockSize) {
+            words_.discard_front(blocks_.front().nwords());
+            words_popped_ += blocks_.pop().nwords();
+            head_valid_ = false;
+            front_pos_ = 0;
+        }
+        return ret;
+    }
+    T pop_front() {
+        return pop(); // Interface compatibility with std::list.
+    }
+    T front() {
+        if(blocks_.size() == 0) return tail_.front();
+        load_head();
+        return head_[front_pos_];
+    }
+    T back() const {return tail_.size() ? tail_.back(): blocks_.back().last;}
+    // Random access decodes (at most) the block holding element i.
+    T operator[](size_t i) const {
+        i += front_pos_;
+        const size_t bi = i / BlockSize;
+        if(bi >= blocks_.size()) return tail_[SizeType(i - size_t(blocks_.size()) * BlockSize)];
+        if(bi == 0 && head_valid_) return head_[i];
+        T tmp[BlockSize];
+        decode(SizeType(bi), tmp);
+        return tmp[i % BlockSize];
+    }
+    // Index of the first element >= x, or size() if there is none.
+    size_t lower_bound(T x) const {
+        // The first block whose last value is >= x holds the answer, unless the tail does.
+        size_t lo = 0, hi = blocks_.size();
+        while(lo < hi) {
+            const size_t mid = (lo + hi) / 2;
+            if(blocks_[SizeType(mid)].last < x) lo = mid + 1;
+            else hi = mid;
+        }
+        if(lo == blocks_.size()) {
+            size_t i = 0;
+            for(; i < tail_.size() && tail_[SizeType(i)] < x; ++i);
+            return size() - tail_.size() + i;
+        }
+        T tmp[BlockSize];
+        decode(SizeType(lo), tmp);
+        const unsigned first = lo == 0 ? front_pos_: 0;
+        const unsigned j = unsigned(std::lower_bound(tmp + first, tmp + BlockSize, x) - tmp);
+        return lo * BlockSize + j - front_pos_;
+    }
+    template<typename Functor>
+    void for_each(const Functor &func) const {
+        T tmp[BlockSize];
+        for(size_t bi = 0; bi < blocks_.size(); ++bi) {
+            decode(SizeType(bi), tmp);
+            for(unsigned i = bi ? 0: front_pos_; i < BlockSize; func(tmp[i++]));
+        }
+        tail_.for_each(func);
+    }
+    std::vector<T> to_vector() const {
+        std::vector<T> ret;
+        ret.reserve(size());
+        for_each([&ret](T x) {ret.push_back(x);});
+        return ret;
+    }
+    void clear() {
+        blocks_.clear();
+        words_popped_ += words_.size();
+        words_.clear();
+        tail_.clear();
+        head_valid_ = false;
+        front_pos_ = 0;
+    }
+    size_t size() const noexcept {return size_t(blocks_.size()) * BlockSize - front_pos_ + tail_.size();}
+    bool empty()  const noexcept {return size() == 0;}
+    // Heap bytes held by the packed words, the block index and the uncompressed tail.
+    size_t memory_usage() const noexcept {
+        return (size_t(words_.capacity()) + 1) * sizeof(uint64_t) + (size_t(blocks_.capacity()) + 1) * sizeof(block)
+             + (size_t(tail_.capacity()) + 1) * sizeof(T);
+    }
+}; // delta_deque
+
+} // namespace circ
+
+#endif /* #ifndef CIRCULAR_QUEUE_ENCODED_H__ */
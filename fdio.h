@@ -0,0 +1,62 @@
+#pragma once
+#ifndef CIRCULAR_QUEUE_FDIO_H__
+#define CIRCULAR_QUEUE_FDIO_H__
+#include "cq.h"
+#include <sys/types.h>
+#include <sys/uio.h>   // For readv/writev
+#include <climits>     // For SSIZE_MAX
+
+namespace circ {
+
+// Scatter/gather I/O between a file descriptor and a byte deque, with no intermediate buffer.
+// Both return what readv/writev returned: bytes transferred, 0 at end of file, or -1 with errno set
+// (including EAGAIN on non-blocking descriptors), in which case the deque is unchanged.
+
+template<typename T, typename SizeType>
+static inline int segments_to_iovec(struct iovec *iov, T *const *ptrs, const SizeType *lens, unsigned n, size_t max) {
+    // Describe the first max bytes of the segments; returns the number of iovecs used.
+    int ret = 0;
+    for(unsigned i = 0; i < n && max; ++i, ++ret) {
+        iov[i].iov_base = ptrs[i];
+        iov[i].iov_len = std::min(size_t(lens[i]), max);
+        max -= iov[i].iov_len;
+    }
+    return ret;
+}
+
+// Read up to max bytes onto the back of q, growing it first if fewer than max slots are free.
+template<typename T, typename SizeType, typename Allocator, typename Stats>
+ssize_t read_from_fd(deque<T, SizeType, Allocator, Stats> &q, int fd, size_t max) {
+    static_assert(sizeof(T) == 1 && std::is_trivially_copyable<T>::value, "fd I/O requires a deque of bytes");
+    max = std::min(max, std::min(size_t(SSIZE_MAX), size_t(SizeType(-1) >> 1) - q.size())); // Largest ring SizeType can index.
+    if(size_t(q.capacity() - q.size()) < max) q.reserve(SizeType(q.size() + max));
+    T *ptrs[2];
+    SizeType lens[2];
+    const unsigned n = q.free_segments(ptrs, lens);
+    struct iovec iov[2];
+    const int niov = segments_to_iovec(iov, ptrs, lens, n, max);
+    if(niov == 0) return 0;
+    const ssize_t ret = ::readv(fd, iov, niov);
+    if(ret > 0) q.commit_back(SizeType(ret));
+    return ret;
+}
+
+// Write up to max bytes from the front of q, removing whatever the kernel accepted.
+template<typename T, typename SizeType, typename Allocator, typename Stats>
+ssize_t write_to_fd(deque<T, SizeType, Allocator, Stats> &q, int fd, size_t max=SIZE_MAX) {
+    static_assert(sizeof(T) == 1 && std::is_trivially_copyable<T>::value, "fd I/O requires a deque of bytes");
+    if(max > SSIZE_MAX) max = SSIZE_MAX;
+    T *ptrs[2];
+    SizeType lens[2];
+    const unsigned n = q.used_segments(ptrs, lens);
+    struct iovec iov[2];
+    const int niov = segments_to_iovec(iov, ptrs, lens, n, max);
+    if(niov == 0) return 0;
+    const ssize_t ret = ::writev(fd, iov, niov);
+    if(ret > 0) q.discard_front(SizeType(ret));
+    return ret;
+}
+
+} // namespace circ
+
+#endif /* #ifndef CIRCULAR_QUEUE_FDIO_H__ */
@@ -0,0 +1,124 @@
+#pragma once
+#ifndef CIRCULAR_QUEUE_INCREMENTAL_H__
+#define CIRCULAR_QUEUE_INCREMENTAL_H__
+#include "cq.h"
+
+namespace circ {
+
+template<typename T, typename SizeType=uint32_t, unsigned Step=4, typename Allocator=malloc_allocator>
+class incremental_deque {
+    // A deque whose growth never copies the whole buffer at once.
+    // When cur_ fills, it becomes old_ and a ring of twice the size takes its place. The two coexist:
+    // old_ holds the front of the queue and cur_ the back, and every subsequent operation moves
+    // up to Step elements from the back of old_ to the front of cur_, as with incremental rehashing.
+    // Each push therefore costs O(Step) instead of an occasional O(n) stall.
+    // Since old_ loses at least Step - 1 elements per operation while cur_ has room for twice
+    // as many as old_ held, cur_ cannot fill up before old_ is empty.
+    // Freeing the drained buffer still costs one munmap for very large rings; use reserve() to avoid growth entirely.
+    static_assert(Step >= 2, "Migration must outpace growth");
+    using deque_type = deque<T, SizeType, Allocator>;
+    deque_type cur_;
+    deque_type old_;
+
+    void migrate(unsigned n) {
+        for(; n && old_.size(); --n) cur_.push_front(old_.pop_back());
+        if(old_.size() == 0 && old_.capacity() > 3) old_ = deque_type(3, old_.get_allocator()); // Release the old buffer.
+    }
+    void step() {
+        if(__builtin_expect(old_.size() != 0, 0)) migrate(Step);
+    }
+    void make_room() {
+        if(__builtin_expect(cur_.size() != cur_.capacity(), 1)) return;
+        if(old_.size()) {
+            migrate(UINT_MAX); // Only reachable through unusual mixes of push_front and push_back.
+            return;
+        }
+        old_ = std::move(cur_);
+        cur_ = deque_type((old_.capacity() + 1) * 2 - 1, old_.get_allocator());
+    }
+
+public:
+    using size_type = SizeType;
+    incremental_deque(SizeType size=3, const Allocator &alloc=Allocator()): cur_(size, alloc), old_(3, alloc) {}
+    // Grow immediately, outside the latency-sensitive path. Finishes any migration in progress.
+    void reserve(size_type n) {
+        migrate(UINT_MAX);
+        cur_.reserve(n);
+    }
+    template<typename... Args>
+    T &push_back(Args &&... args) {
+        step();
+        make_room();
+        return cur_.push_back(std::forward<Args>(args)...);
+    }
+    template<typename... Args>
+    T &push_front(Args &&... args) {
+        step();
+        if(old_.size() == 0) make_room(); // May start a migration, after which the front lives in old_.
+        if(old_.size() == 0) return cur_.push_front(std::forward<Args>(args)...);
+        if(old_.size() == old_.capacity()) migrate(1);
+        return old_.push_front(std::forward<Args>(args)...);
+    }
+    template<typename... Args>
+    T &emplace_back(Args &&... args) {
+        return push_back(std::forward<Args>(args)...); // Interface compatibility.
+    }
+    template<typename... Args>
+    T &emplace_front(Args &&... args) {
+        return push_front(std::forward<Args>(args)...); // Interface compatibility.
+    }
+    template<typename... Args>
+    T &push(Args &&... args) {
+        return push_back(std::forward<Args>(args)...); // Interface compatibility
+    }
+    T pop() {
+        step();
+        return old_.size() ? old_.pop(): cur_.pop();
+    }
+    T pop_front() {
+        return pop(); // Interface compatibility with std::list.
+    }
+    T pop_back() {
+        step();
+        return cur_.size() ? cur_.pop_back(): old_.pop_back();
+    }
+    T &front() {return old_.size() ? old_.front(): cur_.front();}
+    const T &front() const {return old_.size() ? old_.front(): cur_.front();}
+    T &back() {return cur_.size() ? cur_.back(): old_.back();}
+    const T &back() const {return cur_.size() ? cur_.back(): old_.back();}
+    T &operator[](size_type i) {
+        const size_type n = old_.size();
+        return i < n ? old_[i]: cur_[i - n];
+    }
+    const T &operator[](size_type i) const {
+        const size_type n = old_.size();
+        return i < n ? old_[i]: cur_[i - n];
+    }
+    template<typename Functor>
+    void for_each(const Functor &func) {
+        old_.for_each(func);
+        cur_.for_each(func);
+    }
+    template<typename Functor>
+    void for_each(const Functor &func) const {
+        old_.for_each(func);
+        cur_.for_each(func);
+    }
+    std::vector<T> to_vector() const {
+        std::vector<T> ret;
+        ret.reserve(size());
+        for_each([&ret](const T &x) {ret.push_back(x);});
+        return ret;
+    }
+    void clear() {
+        old_.clear();
+        cur_.clear();
+    }
+    bool migrating()     const noexcept {return old_.size() != 0;}
+    size_type size()     const noexcept {return old_.size() + cur_.size();}
+    size_type capacity() const noexcept {return cur_.capacity();}
+}; // incremental_deque
+
+} // namespace circ
+
+#endif /* #ifndef CIRCULAR_QUEUE_INCREMENTAL_H__ */
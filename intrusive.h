@@ -0,0 +1,196 @@
+#pragma once
+#ifndef CIRCULAR_QUEUE_INTRUSIVE_H__
+#define CIRCULAR_QUEUE_INTRUSIVE_H__
+#include "cq.h"
+#include <atomic>      // For std::atomic
+#include <memory>      // For std::unique_ptr
+
+namespace circ {
+
+template<typename T, unsigned TagBits>
+struct tagged_ptr {
+    // A pointer with a small tag (state, priority, ...) in its alignment bits. Zero is reserved
+    // for tombstones, so a tagged_ptr in a ring never holds nullptr.
+    static constexpr uintptr_t tag_mask = (uintptr_t(1) << TagBits) - 1;
+    uintptr_t bits;
+    tagged_ptr(uintptr_t b=0): bits(b) {}
+    tagged_ptr(T *ptr, unsigned tag): bits(reinterpret_cast<uintptr_t>(ptr) | (tag & tag_mask)) {
+        assert((reinterpret_cast<uintptr_t>(ptr) & tag_mask) == 0);
+        assert(tag <= tag_mask);
+    }
+    T *ptr()       const {return reinterpret_cast<T *>(bits & ~tag_mask);}
+    unsigned tag() const {return unsigned(bits & tag_mask);}
+    explicit operator bool() const {return bits != 0;}
+    bool operator==(tagged_ptr o) const {return bits == o.bits;}
+    bool operator!=(tagged_ptr o) const {return bits != o.bits;}
+};
+
+template<typename T, unsigned TagBits=__builtin_ctz(alignof(T)), typename SizeType=uint32_t>
+class pointer_ring {
+    // A FIFO of pointers to objects owned elsewhere: a push is a single word store into a power-of-two
+    // ring, with no construction and no allocation once capacity is reached, unlike deque<T *>'s placement new.
+    // Each slot holds a tagged_ptr whose low TagBits carry caller state. Slots are atomic words, so a
+    // queued element can be retagged or cancelled in O(1) through the position push() returned by
+    // compare-and-swap, even from other threads. Cancelling leaves a tombstone (zero) which pop() skips.
+    // push, pop, reserve and for_each belong to one owner thread. Other threads may call load,
+    // compare_exchange, retag and cancel concurrently, provided the ring does not grow meanwhile
+    // (reserve() up front): growth moves the slots. A position is only meaningful until it is popped;
+    // pass the expected pointer to cancel() from another thread, so that a slot reused a lap later is left alone.
+    static_assert(std::is_unsigned<SizeType>::value, "Must be unsigned");
+    static_assert(TagBits < 8 && (uintptr_t(1) << TagBits) <= alignof(T), "Tags must fit in the pointer's alignment bits");
+public:
+    using tagged = tagged_ptr<T, TagBits>;
+    using size_type = SizeType;
+    using value_type = T *;
+private:
+    using slot_type = std::atomic<uintptr_t>;
+    std::unique_ptr<slot_type[]> slots_;
+    uint64_t                     mask_;
+    std::atomic<uint64_t>        head_; // Position of the oldest slot, which may be a tombstone.
+    std::atomic<uint64_t>        tail_; // Position the next push will take.
+    std::atomic<uint64_t>        dead_; // Tombstones between head_ and tail_.
+
+    slot_type &slot(uint64_t pos) const {return slots_[pos & mask_];}
+    bool queued(uint64_t pos) const {
+        return pos >= head_.load(std::memory_order_acquire) && pos < tail_.load(std::memory_order_acquire);
+    }
+    void grow(uint64_t nslots) {
+        const uint64_t head = head_.load(std::memory_order_relaxed), tail = tail_.load(std::memory_order_relaxed);
+        std::unique_ptr<slot_type[]> tmp(new slot_type[nslots]);
+        for(uint64_t pos = head; pos < tail; ++pos)
+            tmp[pos & (nslots - 1)].store(slot(pos).load(std::memory_order_relaxed), std::memory_order_relaxed);
+        slots_ = std::move(tmp);
+        mask_ = nslots - 1;
+    }
+
+public:
+    pointer_ring(SizeType size=16):
+        slots_(new slot_type[std::max(roundup(uint64_t(size)), uint64_t(2))]),
+        mask_(std::max(roundup(uint64_t(size)), uint64_t(2)) - 1), head_(0), tail_(0), dead_(0) {}
+    pointer_ring(const pointer_ring &) = delete;
+    pointer_ring &operator=(const pointer_ring &) = delete;
+
+    // Returns the element's position, its handle for load, compare_exchange, retag and cancel.
+    uint64_t push(T *ptr, unsigned tag=0) {
+        if(__builtin_expect(ptr == nullptr, 0)) throw std::runtime_error("pointer_ring cannot hold nullptr. Abort!");
+        const uint64_t tail = tail_.load(std::memory_order_relaxed);
+        if(__builtin_expect(tail - head_.load(std::memory_order_relaxed) > mask_, 0)) {
+            if(__builtin_expect(mask_ + 1 > std::numeric_limits<SizeType>::max() / 2, 0))
+                throw std::bad_alloc();
+            grow((mask_ + 1) * 2);
+        }
+        slot(tail).store(tagged(ptr, tag).bits, std::memory_order_release);
+        tail_.store(tail + 1, std::memory_order_release);
+        return tail;
+    }
+    uint64_t push_back(T *ptr, unsigned tag=0) {
+        return push(ptr, tag); // Interface compatibility
+    }
+    // Removes and returns the oldest live element, skipping tombstones; null when none is left.
+    tagged pop_tagged() {
+        uint64_t head = head_.load(std::memory_order_relaxed);
+        const uint64_t tail = tail_.load(std::memory_order_relaxed);
+        tagged ret;
+        for(; head < tail; ++head) {
+            // Claim the slot by swapping in a tombstone: zero means a concurrent cancel got there first.
+            const uintptr_t bits = slot(head).exchange(0, std::memory_order_acq_rel);
+            if(bits) {
+                ret = tagged(bits);
+                ++head;
+                break;
+            }
+            dead_.fetch_sub(1, std::memory_order_relaxed);
+        }
+        head_.store(head, std::memory_order_release);
+        return ret;
+    }
+    T *pop() {return pop_tagged().ptr();}
+    T *pop(unsigned &tag) {
+        const tagged ret(pop_tagged());
+        tag = ret.tag();
+        return ret.ptr();
+    }
+    T *pop_front() {
+        return pop(); // Interface compatibility
+    }
+    // The oldest live element without removing it; null when none is left. Drops leading tombstones.
+    tagged front() {
+        uint64_t head = head_.load(std::memory_order_relaxed);
+        const uint64_t tail = tail_.load(std::memory_order_relaxed);
+        tagged ret;
+        for(; head < tail; ++head) {
+            if((ret = tagged(slot(head).load(std::memory_order_acquire)))) break;
+            dead_.fetch_sub(1, std::memory_order_relaxed);
+        }
+        head_.store(head, std::memory_order_release);
+        return ret;
+    }
+    // Current contents of the slot at pos: null once popped or cancelled.
+    tagged load(uint64_t pos) const {
+        return queued(pos) ? tagged(slot(pos).load(std::memory_order_acquire)): tagged();
+    }
+    // Replaces the slot at pos with desired if it still holds expected; otherwise loads it into expected.
+    // desired may not be null: use cancel to remove an element.
+    bool compare_exchange(uint64_t pos, tagged &expected, tagged desired) {
+        assert(desired);
+        if(!queued(pos)) {
+            expected = tagged();
+            return false;
+        }
+        if(!expected) {
+            expected = tagged(slot(pos).load(std::memory_order_acquire));
+            return false;
+        }
+        return slot(pos).compare_exchange_strong(expected.bits, desired.bits, std::memory_order_acq_rel, std::memory_order_acquire);
+    }
+    // Sets the tag of a queued element. False if it was popped or cancelled first.
+    bool retag(uint64_t pos, unsigned tag) {
+        if(!queued(pos)) return false;
+        slot_type &s = slot(pos);
+        uintptr_t bits = s.load(std::memory_order_relaxed);
+        while(bits && !s.compare_exchange_weak(bits, (bits & ~tagged::tag_mask) | (tag & tagged::tag_mask),
+                                               std::memory_order_acq_rel, std::memory_order_relaxed));
+        return bits != 0;
+    }
+    // Turns the element at pos into a tombstone, if it is still queued (and is expected, when given).
+    // Exactly one of cancel and pop succeeds for each element.
+    bool cancel(uint64_t pos, const T *expected=nullptr) {
+        if(!queued(pos)) return false;
+        slot_type &s = slot(pos);
+        uintptr_t bits = s.load(std::memory_order_relaxed);
+        for(;;) {
+            if(bits == 0 || (expected && tagged(bits).ptr() != expected)) return false;
+            if(s.compare_exchange_weak(bits, 0, std::memory_order_acq_rel, std::memory_order_relaxed)) break;
+        }
+        dead_.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+    // Calls func(T *, unsigned tag) for each live element, oldest first.
+    template<typename Functor>
+    void for_each(const Functor &func) const {
+        const uint64_t tail = tail_.load(std::memory_order_relaxed);
+        for(uint64_t pos = head_.load(std::memory_order_relaxed); pos < tail; ++pos)
+            if(const tagged t = tagged(slot(pos).load(std::memory_order_acquire))) func(t.ptr(), t.tag());
+    }
+    void reserve(SizeType n) {
+        if(n > mask_ + 1) grow(roundup(uint64_t(n)));
+    }
+    void clear() {
+        head_.store(tail_.load(std::memory_order_relaxed), std::memory_order_release);
+        dead_.store(0, std::memory_order_relaxed);
+    }
+    // Live elements; approximate while other threads are cancelling.
+    size_t size() const {
+        const uint64_t n = tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire);
+        const uint64_t dead = dead_.load(std::memory_order_relaxed); // pop may reclaim a tombstone before cancel counts it.
+        return dead > n ? 0: n - dead;
+    }
+    bool empty() const {return size() == 0;}
+    // Cancelled slots not yet reclaimed by pop.
+    size_t tombstones() const {return dead_.load(std::memory_order_relaxed);}
+    uint64_t capacity() const noexcept {return mask_ + 1;}
+}; // pointer_ring
+
+} // namespace circ
+
+#endif /* #ifndef CIRCULAR_QUEUE_INTRUSIVE_H__ */
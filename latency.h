@@ -0,0 +1,180 @@
+#pragma once
+#ifndef CIRCULAR_QUEUE_LATENCY_H__
+#define CIRCULAR_QUEUE_LATENCY_H__
+#include "cq.h"
+#include <cmath>       // For std::ceil
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h> // For __rdtsc
+#endif
+
+namespace circ {
+
+struct steady_ns {
+    // Timestamp source in nanoseconds.
+    static uint64_t now() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+};
+
+struct tsc_ticks {
+    // Timestamp counter ticks; a fraction of the cost of steady_clock, but in cycles rather than ns.
+    // Falls back to steady_ns off x86.
+    static uint64_t now() {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        return steady_ns::now();
+#endif
+    }
+};
+
+template<unsigned SubBits=5>
+class log_linear_histogram {
+    // HDR-style histogram over uint64_t values.
+    // Values below 2^SubBits are counted exactly. Above that, each power of two is split into
+    // 2^SubBits linear sub-buckets, so every recorded value is known to within 2^-SubBits relative error.
+    // Recording is a count-leading-zeros, a shift and an increment. Not threadsafe: keep one per
+    // thread and merge() them to report.
+    static_assert(SubBits >= 1 && SubBits < 16, "Unreasonable histogram precision");
+    static constexpr unsigned sub_count = 1u << SubBits;
+    static constexpr unsigned nbuckets = (64 - SubBits + 1) * sub_count;
+    uint64_t counts_[nbuckets];
+    uint64_t total_;
+    uint64_t min_;
+    uint64_t max_;
+    uint64_t sum_;
+
+    static unsigned index(uint64_t v) {
+        if(v < sub_count) return unsigned(v);
+        const unsigned e = 63 - __builtin_clzll(v);
+        return ((e - SubBits + 1) << SubBits) | unsigned((v >> (e - SubBits)) & (sub_count - 1));
+    }
+    static uint64_t lowest(unsigned i) {
+        if(i < sub_count) return i;
+        return uint64_t(sub_count | (i & (sub_count - 1))) << ((i >> SubBits) - 1);
+    }
+    static uint64_t highest(unsigned i) {
+        return i < sub_count ? i: lowest(i) + (uint64_t(1) << ((i >> SubBits) - 1)) - 1;
+    }
+
+public:
+    log_linear_histogram() {reset();}
+    void reset() {
+        std::memset(counts_, 0, sizeof(counts_));
+        total_ = sum_ = max_ = 0;
+        min_ = UINT64_MAX;
+    }
+    void record(uint64_t v, uint64_t n=1) {
+        counts_[index(v)] += n;
+        total_ += n;
+        sum_ += v * n;
+        min_ = std::min(min_, v);
+        max_ = std::max(max_, v);
+    }
+    void merge(const log_linear_histogram &o) {
+        for(unsigned i = 0; i < nbuckets; ++i) counts_[i] += o.counts_[i];
+        total_ += o.total_;
+        sum_ += o.sum_;
+        min_ = std::min(min_, o.min_);
+        max_ = std::max(max_, o.max_);
+    }
+    // Smallest value v such that a fraction q of recordings were <= v, up to bucket precision.
+    uint64_t percentile(double q) const {
+        if(total_ == 0) return 0;
+        const uint64_t target = std::max(uint64_t(1), uint64_t(std::ceil(q * total_)));
+        uint64_t seen = 0;
+        for(unsigned i = 0; i < nbuckets; ++i)
+            if((seen += counts_[i]) >= target)
+                return std::min(highest(i), max_);
+        return max_;
+    }
+    uint64_t count() const {return total_;}
+    uint64_t min()   const {return total_ ? min_: 0;}
+    uint64_t max()   const {return max_;}
+    double   mean()  const {return total_ ? double(sum_) / total_: 0.;}
+    // Calls func(lowest, highest, count) for each non-empty bucket, in increasing order.
+    template<typename Functor>
+    void for_each_bucket(const Functor &func) const {
+        for(unsigned i = 0; i < nbuckets; ++i)
+            if(counts_[i]) func(lowest(i), highest(i), counts_[i]);
+    }
+}; // log_linear_histogram
+
+template<typename T, typename SizeType=uint32_t, typename Clock=steady_ns, unsigned SubBits=5>
+class timed_deque {
+    // A deque which measures how long each element spends queued.
+    // Timestamps live in a second deque of the same capacity which sees exactly the same sequence
+    // of pushes and pops, so both always share one mask and T itself is left untouched.
+    // Each pop records now() - push time in a log-linear histogram.
+    using histogram_type = log_linear_histogram<SubBits>;
+    deque<T, SizeType>        items_;
+    deque<uint64_t, SizeType> stamps_;
+    histogram_type            sojourn_;
+
+public:
+    using size_type = SizeType;
+    timed_deque(SizeType size=3): items_(size), stamps_(size) {}
+    template<typename... Args>
+    T &push_back(Args &&... args) {
+        stamps_.push_back(Clock::now());
+        return items_.push_back(std::forward<Args>(args)...);
+    }
+    template<typename... Args>
+    T &push_front(Args &&... args) {
+        stamps_.push_front(Clock::now());
+        return items_.push_front(std::forward<Args>(args)...);
+    }
+    template<typename... Args>
+    T &emplace_back(Args &&... args) {
+        return push_back(std::forward<Args>(args)...); // Interface compatibility.
+    }
+    template<typename... Args>
+    T &emplace_front(Args &&... args) {
+        return push_front(std::forward<Args>(args)...); // Interface compatibility.
+    }
+    template<typename... Args>
+    T &push(Args &&... args) {
+        return push_back(std::forward<Args>(args)...); // Interface compatibility
+    }
+    T pop() {
+        T ret(items_.pop());
+        sojourn_.record(Clock::now() - stamps_.pop());
+        assert(items_.mask() == stamps_.mask());
+        return ret;
+    }
+    T pop_front() {
+        return pop(); // Interface compatibility with std::list.
+    }
+    T pop_back() {
+        T ret(items_.pop_back());
+        sojourn_.record(Clock::now() - stamps_.pop_back());
+        return ret;
+    }
+    T &front() {return items_.front();}
+    const T &front() const {return items_.front();}
+    T &back() {return items_.back();}
+    const T &back() const {return items_.back();}
+    // Time the front element has been waiting, in Clock units.
+    uint64_t front_age() const {return Clock::now() - stamps_.front();}
+    template<typename Functor>
+    void for_each(const Functor &func) {items_.for_each(func);}
+    template<typename Functor>
+    void for_each(const Functor &func) const {items_.for_each(func);}
+    void reserve(size_type n) {
+        items_.reserve(n);
+        stamps_.reserve(n);
+    }
+    void clear() {
+        items_.clear();
+        stamps_.clear();
+    }
+    size_type size()     const noexcept {return items_.size();}
+    size_type capacity() const noexcept {return items_.capacity();}
+    const histogram_type &histogram() const {return sojourn_;}
+    histogram_type snapshot() const {return sojourn_;}
+    void reset_histogram() {sojourn_.reset();}
+}; // timed_deque
+
+} // namespace circ
+
+#endif /* #ifndef CIRCULAR_QUEUE_LATENCY_H__ */
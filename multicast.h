@@ -0,0 +1,154 @@
+#pragma once
+#ifndef CIRCULAR_QUEUE_MULTICAST_H__
+#define CIRCULAR_QUEUE_MULTICAST_H__
+#include "cq.h"
+#include "spinlock.h"  // For circ::backoff
+#include <initializer_list>
+
+namespace circ {
+
+template<typename T, typename SizeType=uint32_t>
+class multicast_ring {
+    // A single-producer, multi-consumer broadcast ring in the style of the LMAX Disruptor.
+    // Every consumer sees every element, but all of them read from the same buffer, so
+    // fanning a stream out to N consumers costs one copy instead of N.
+    // Each consumer owns a sequence number. The producer may not lap the slowest consumer
+    // (gating), and a consumer may be made to follow others (a barrier) so it only sees
+    // elements they have already released.
+    // Sequences are 64-bit and monotone; the slot for sequence i is i & mask_.
+    // Only one thread may push, and each consumer id may only be used from one thread at a time.
+    static_assert(std::is_unsigned<SizeType>::value, "Must be unsigned");
+    struct alignas(CIRC_CACHELINE_SIZE) consumer {
+        std::atomic<uint64_t> seq_;
+        std::vector<unsigned> deps_;
+        bool                  gating_;
+        consumer(): seq_(0), gating_(true) {}
+    };
+    struct alignas(CIRC_CACHELINE_SIZE) cursor {
+        std::atomic<uint64_t> seq_;
+        cursor(): seq_(0) {}
+    };
+
+    SizeType                    mask_;
+    unsigned                    nconsumers_;
+    aligned_array<consumer>     consumers_;
+    T                          *data_;       // Allocated last, so nothing leaks if it fails.
+    cursor                      cursor_;
+    uint64_t                    cached_gate_; // Only touched by the producer.
+
+    uint64_t gate() const {
+        uint64_t ret = UINT64_MAX;
+        for(unsigned i = 0; i < nconsumers_; ++i)
+            if(consumers_[i].gating_)
+                ret = std::min(ret, consumers_[i].seq_.load(std::memory_order_acquire));
+        return ret;
+    }
+    uint64_t limit(unsigned id) const {
+        uint64_t ret = cursor_.seq_.load(std::memory_order_acquire);
+        for(const auto dep: consumers_[id].deps_)
+            ret = std::min(ret, consumers_[dep].seq_.load(std::memory_order_acquire));
+        return ret;
+    }
+    bool reaches(unsigned from, unsigned to) const {
+        // Whether consumer `from` waits on `to`, directly or through other consumers.
+        if(from == to) return true;
+        for(const auto dep: consumers_[from].deps_)
+            if(reaches(dep, to)) return true;
+        return false;
+    }
+    bool has_room(uint64_t seq) {
+        if(seq - cached_gate_ <= mask_) return true;
+        cached_gate_ = gate();
+        return seq - cached_gate_ <= mask_;
+    }
+    template<typename... Args>
+    void publish(uint64_t seq, Args &&... args) {
+        T *slot = data_ + (seq & mask_);
+        if(seq > mask_) slot->~T(); // Every gating consumer has released the previous occupant.
+        new(slot) T(std::forward<Args>(args)...);
+        cursor_.seq_.store(seq + 1, std::memory_order_release);
+    }
+
+public:
+    using size_type = SizeType;
+    multicast_ring(SizeType size, unsigned nconsumers):
+        mask_(roundup(std::max(size, SizeType(2))) - 1),
+        nconsumers_(nconsumers ? nconsumers: throw std::runtime_error("multicast_ring requires at least one consumer.")),
+        consumers_(nconsumers),
+        data_(static_cast<T *>(std::malloc((size_t(mask_) + 1) * sizeof(T)))),
+        cached_gate_(0)
+    {
+        if(data_ == nullptr) throw std::bad_alloc();
+    }
+    multicast_ring(const multicast_ring &) = delete;
+    multicast_ring &operator=(const multicast_ring &) = delete;
+    ~multicast_ring() {
+        const uint64_t end = cursor_.seq_.load(std::memory_order_relaxed);
+        for(uint64_t i = end > mask_ ? end - mask_ - 1: 0; i < end; ++i)
+            data_[i & mask_].~T();
+        std::free(data_);
+    }
+    // Make consumer `id` wait on `leader`: it will only see elements `leader` has released.
+    // Must be called before any elements are pushed or consumed, and may not create a cycle.
+    void follow(unsigned id, unsigned leader) {
+        if(__builtin_expect(id >= nconsumers_ || leader >= nconsumers_, 0))
+            throw std::runtime_error("Invalid consumer dependency.");
+        if(__builtin_expect(published() != 0, 0))
+            throw std::runtime_error("multicast_ring dependencies must be set before any elements are pushed.");
+        if(__builtin_expect(reaches(leader, id), 0))
+            throw std::runtime_error("multicast_ring dependencies may not form a cycle.");
+        consumers_[id].deps_.push_back(leader);
+        // Only the ends of dependency chains need to gate the producer.
+        consumers_[leader].gating_ = false;
+    }
+    void follow(unsigned id, std::initializer_list<unsigned> leaders) {
+        for(const auto leader: leaders) follow(id, leader);
+    }
+    template<typename... Args>
+    bool try_push(Args &&... args) {
+        const uint64_t seq = cursor_.seq_.load(std::memory_order_relaxed);
+        if(!has_room(seq)) return false;
+        publish(seq, std::forward<Args>(args)...);
+        return true;
+    }
+    template<typename... Args>
+    void push(Args &&... args) {
+        const uint64_t seq = cursor_.seq_.load(std::memory_order_relaxed);
+        for(backoff wait; !has_room(seq); wait());
+        publish(seq, std::forward<Args>(args)...);
+    }
+    template<typename... Args>
+    void push_back(Args &&... args) {
+        push(std::forward<Args>(args)...); // Interface compatibility
+    }
+    // Number of elements ready for consumer `id`.
+    size_t available(unsigned id) const {
+        return limit(id) - consumers_[id].seq_.load(std::memory_order_relaxed);
+    }
+    // Calls func on up to `max` ready elements, then releases them. Returns the number consumed.
+    template<typename Functor>
+    size_t try_consume(unsigned id, const Functor &func, size_t max=SIZE_MAX) {
+        consumer &c = consumers_[id];
+        const uint64_t start = c.seq_.load(std::memory_order_relaxed);
+        const uint64_t stop = start + std::min(max, size_t(limit(id) - start));
+        for(uint64_t i = start; i != stop; func(static_cast<const T &>(data_[i++ & mask_])));
+        c.seq_.store(stop, std::memory_order_release);
+        return stop - start;
+    }
+    // Blocks until at least one element is ready.
+    template<typename Functor>
+    size_t consume(unsigned id, const Functor &func, size_t max=SIZE_MAX) {
+        size_t ret;
+        for(backoff wait; (ret = try_consume(id, func, max)) == 0; wait());
+        return ret;
+    }
+    uint64_t sequence(unsigned id) const {return consumers_[id].seq_.load(std::memory_order_acquire);}
+    uint64_t published() const {return cursor_.seq_.load(std::memory_order_acquire);}
+    unsigned consumers() const noexcept {return nconsumers_;}
+    size_type capacity() const noexcept {return mask_ + 1;}
+    size_type mask() const noexcept {return mask_;}
+}; // multicast_ring
+
+} // namespace circ
+
+#endif /* #ifndef CIRCULAR_QUEUE_MULTICAST_H__ */
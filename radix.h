@@ -0,0 +1,105 @@
+#pragma once
+#ifndef CIRCULAR_QUEUE_RADIX_H__
+#define CIRCULAR_QUEUE_RADIX_H__
+#include "cq.h"
+
+namespace circ {
+
+template<typename Key, typename Value, typename SizeType=uint32_t>
+class radix_heap {
+    // A monotone priority queue over unsigned integer keys: no key pushed may be smaller than the
+    // last one popped, as in Dijkstra and event simulation.
+    // Bucket 0 holds keys equal to last_, the last key popped, and bucket i > 0 holds keys whose highest
+    // bit differing from last_ is bit i - 1. Push is a count-leading-zeros and a push_back.
+    // When bucket 0 runs dry, the first non-empty bucket is scanned for its minimum, which becomes last_,
+    // and its elements redistributed into strictly lower buckets, so each element moves at most
+    // bits(Key) times: pop is amortized O(log C) for keys spanning a range of C.
+    // Buckets are circ::deques which keep their buffers when emptied, so after warm-up, redistribution
+    // allocates nothing.
+    static_assert(std::is_unsigned<Key>::value, "radix_heap keys must be unsigned");
+    static constexpr unsigned key_bits = sizeof(Key) * CHAR_BIT;
+    struct entry {
+        Key   key;
+        Value value;
+        template<typename... Args>
+        entry(Key k, Args &&... args): key(k), value(std::forward<Args>(args)...) {}
+    };
+    using bucket_type = deque<entry, SizeType>;
+    bucket_type buckets_[key_bits + 1];
+    uint64_t    nonempty_; // Bit i - 1 set if bucket i > 0 has elements.
+    Key         last_;
+    size_t      size_;
+
+    unsigned bucket(Key key) const {
+        return key == last_ ? 0: 64 - __builtin_clzll(uint64_t(key ^ last_));
+    }
+    void refill() {
+        // Bucket 0 is empty: move the smallest keys into it.
+        assert(size_ != 0 && buckets_[0].size() == 0);
+        const unsigned i = __builtin_ctzll(nonempty_) + 1;
+        bucket_type &b = buckets_[i];
+        Key least = b.front().key;
+        b.for_each([&least](const entry &e) {least = std::min(least, e.key);});
+        last_ = least;
+        while(b.size()) {
+            entry e(b.pop());
+            const unsigned j = bucket(e.key);
+            if(j) nonempty_ |= uint64_t(1) << (j - 1);
+            buckets_[j].push_back(std::move(e));
+        }
+        nonempty_ &= ~(uint64_t(1) << (i - 1));
+    }
+
+public:
+    using size_type = size_t;
+    using key_type = Key;
+    using value_type = Value;
+    radix_heap(Key min_key=0): nonempty_(0), last_(min_key), size_(0) {}
+    template<typename... Args>
+    Value &push(Key key, Args &&... args) {
+        if(__builtin_expect(key < last_, 0)) {
+            if(size_ == 0) last_ = key; // An empty heap can restart anywhere.
+            else throw std::runtime_error("Key " + std::to_string(key) + " is below the last key popped from radix_heap (" + std::to_string(last_) + "). Abort!");
+        }
+        const unsigned i = bucket(key);
+        if(i) nonempty_ |= uint64_t(1) << (i - 1);
+        ++size_;
+        return buckets_[i].push_back(key, std::forward<Args>(args)...).value;
+    }
+    template<typename... Args>
+    Value &emplace(Key key, Args &&... args) {
+        return push(key, std::forward<Args>(args)...); // Interface compatibility.
+    }
+    // Smallest key. Requires !empty().
+    Key top_key() {
+        if(buckets_[0].size() == 0) refill();
+        return last_;
+    }
+    Value &top() {
+        if(buckets_[0].size() == 0) refill();
+        return buckets_[0].back().value;
+    }
+    // Removes an element with the smallest key; no order among equal keys.
+    Value pop() {
+        if(__builtin_expect(size_ == 0, 0)) throw std::runtime_error("Popping item from empty buffer. Abort!");
+        if(buckets_[0].size() == 0) refill();
+        --size_;
+        return buckets_[0].pop_back().value;
+    }
+    Value pop(Key &key) {
+        Value ret(pop());
+        key = last_;
+        return ret;
+    }
+    void clear() {
+        for(auto &b: buckets_) b.clear();
+        nonempty_ = 0;
+        size_ = 0;
+    }
+    size_t size() const noexcept {return size_;}
+    bool empty()  const noexcept {return size_ == 0;}
+}; // radix_heap
+
+} // namespace circ
+
+#endif /* #ifndef CIRCULAR_QUEUE_RADIX_H__ */
@@ -0,0 +1,188 @@
+#pragma once
+#ifndef CIRCULAR_QUEUE_SEGMENTED_H__
+#define CIRCULAR_QUEUE_SEGMENTED_H__
+#include "cq.h"
+
+namespace circ {
+
+template<typename T>
+constexpr unsigned default_block_shift() {
+    // Largest power of two number of elements fitting in 4 KiB, at least 1.
+    unsigned ret = 0;
+    while((sizeof(T) << (ret + 1)) <= 4096) ++ret;
+    return ret;
+}
+
+template<typename T, typename SizeType=uint32_t, unsigned BlockShift=default_block_shift<T>(), typename Allocator=malloc_allocator>
+class segmented_deque: private Allocator {
+    // A deque stored as fixed-size blocks of 1 << BlockShift elements, found through a
+    // circ::deque of block pointers. Growing adds a block and at most moves pointers in the map,
+    // so elements are never relocated and references to them stay valid until they are popped.
+    // Use this instead of deque for large or non-movable T.
+    // Element i lives at blocks_[(start_ + i) >> BlockShift][(start_ + i) & (block_size - 1)].
+    // One emptied block is kept in reserve so a queue hovering around a block boundary doesn't thrash malloc.
+    static_assert(std::is_unsigned<SizeType>::value, "Must be unsigned");
+    static constexpr SizeType block_size = SizeType(1) << BlockShift;
+    static constexpr SizeType block_mask = block_size - 1;
+    deque<T *, SizeType, Allocator> blocks_;
+    SizeType                        start_; // Offset of the front element within blocks_.front().
+    SizeType                        size_;
+    T                              *spare_;
+
+    T *new_block() {
+        T *ret = spare_;
+        if(ret) spare_ = nullptr;
+        else if((ret = static_cast<T *>(this->allocate(sizeof(T) * block_size))) == nullptr) throw std::bad_alloc();
+        return ret;
+    }
+    void release_block(T *block) {
+        if(spare_) this->deallocate(block, sizeof(T) * block_size);
+        else spare_ = block;
+    }
+    T *address(SizeType i) const {
+        const SizeType pos = start_ + i;
+        return blocks_[pos >> BlockShift] + (pos & block_mask);
+    }
+
+public:
+    using size_type = SizeType;
+    using allocator_type = Allocator;
+    class iterator {
+        segmented_deque *ref_;
+        SizeType         pos_; // Logical index from the front.
+    public:
+        iterator(segmented_deque &ref, SizeType pos): ref_(&ref), pos_(pos) {}
+        T &operator*() const {return (*ref_)[pos_];}
+        T *operator->() const {return &(*ref_)[pos_];}
+        iterator &operator++() {++pos_; return *this;}
+        iterator operator++(int) {iterator copy(*this); ++pos_; return copy;}
+        std::ptrdiff_t operator-(const iterator &o) const {return std::ptrdiff_t(pos_) - std::ptrdiff_t(o.pos_);}
+        bool operator==(const iterator &o) const {return pos_ == o.pos_;}
+        bool operator!=(const iterator &o) const {return pos_ != o.pos_;}
+    };
+
+    segmented_deque(const Allocator &alloc=Allocator()):
+        Allocator(alloc), blocks_(3, alloc), start_(0), size_(0), spare_(nullptr) {}
+    segmented_deque(const segmented_deque &) = delete;
+    segmented_deque &operator=(const segmented_deque &) = delete;
+    ~segmented_deque() {
+        clear();
+        while(blocks_.size()) this->deallocate(blocks_.pop(), sizeof(T) * block_size);
+        this->deallocate(spare_, sizeof(T) * block_size);
+    }
+    allocator_type get_allocator() const {return static_cast<const Allocator &>(*this);}
+    iterator begin() {return iterator(*this, 0);}
+    iterator end()   {return iterator(*this, size_);}
+    template<typename... Args>
+    T &push_back(Args &&... args) {
+        const SizeType pos = start_ + size_;
+        if(__builtin_expect((pos >> BlockShift) == blocks_.size(), 0)) {
+            blocks_.reserve(blocks_.size() + 1); // Grow the index first, so the new block is never left unowned.
+            blocks_.push_back(new_block());
+        }
+        T *ret = new(blocks_[pos >> BlockShift] + (pos & block_mask)) T(std::forward<Args>(args)...);
+        ++size_;
+        return *ret;
+    }
+    template<typename... Args>
+    T &push_front(Args &&... args) {
+        if(__builtin_expect(start_ == 0, 0)) {
+            blocks_.reserve(blocks_.size() + 1); // Grow the index first, so the new block is never left unowned.
+            blocks_.push_front(new_block());
+            start_ = block_size;
+        }
+        T *ret;
+        try {
+            ret = new(blocks_.front() + (start_ - 1)) T(std::forward<Args>(args)...);
+        } catch(...) {
+            if(start_ == block_size) release_block(blocks_.pop()), start_ = 0; // An empty front block breaks front().
+            throw;
+        }
+        --start_;
+        ++size_;
+        return *ret;
+    }
+    template<typename... Args>
+    T &emplace_back(Args &&... args) {
+        return push_back(std::forward<Args>(args)...); // Interface compatibility.
+    }
+    template<typename... Args>
+    T &emplace_front(Args &&... args) {
+        return push_front(std::forward<Args>(args)...); // Interface compatibility.
+    }
+    template<typename... Args>
+    T &push(Args &&... args) {
+        return push_back(std::forward<Args>(args)...); // Interface compatibility
+    }
+    // Destroy the front element without moving it out, for types which can't be moved.
+    void discard_front() {
+        if(__builtin_expect(size_ == 0, 0)) throw std::runtime_error("Popping item from empty buffer. Abort!");
+        blocks_.front()[start_].~T();
+        --size_;
+        if(__builtin_expect(++start_ == block_size, 0)) {
+            release_block(blocks_.pop());
+            start_ = 0;
+        }
+    }
+    void discard_back() {
+        if(__builtin_expect(size_ == 0, 0)) throw std::runtime_error("Popping item from empty buffer. Abort!");
+        address(--size_)->~T();
+        const SizeType pos = start_ + size_;
+        if(__builtin_expect((pos & block_mask) == 0, 0) && blocks_.size() > (pos >> BlockShift))
+            release_block(blocks_.pop_back());
+    }
+    T pop() {
+        if(__builtin_expect(size_ == 0, 0)) throw std::runtime_error("Popping item from empty buffer. Abort!");
+        T ret(std::move(front()));
+        discard_front();
+        return ret;
+    }
+    T pop_front() {
+        return pop(); // Interface compatibility with std::list.
+    }
+    T pop_back() {
+        if(__builtin_expect(size_ == 0, 0)) throw std::runtime_error("Popping item from empty buffer. Abort!");
+        T ret(std::move(back()));
+        discard_back();
+        return ret;
+    }
+    T &operator[](size_type i) {return *address(i);}
+    const T &operator[](size_type i) const {return *address(i);}
+    T &front() {return blocks_.front()[start_];}
+    const T &front() const {return blocks_.front()[start_];}
+    T &back() {return *address(size_ - 1);}
+    const T &back() const {return *address(size_ - 1);}
+    template<typename Functor>
+    void for_each(const Functor &func) {
+        // Block by block, so the inner loop is over contiguous memory.
+        SizeType left = size_, offset = start_;
+        for(SizeType b = 0; left; ++b, offset = 0) {
+            const SizeType n = std::min(left, SizeType(block_size - offset));
+            for(T *p = blocks_[b] + offset, *e = p + n; p != e; func(*p++));
+            left -= n;
+        }
+    }
+    template<typename Functor>
+    void for_each(const Functor &func) const {
+        const_cast<segmented_deque *>(this)->for_each([&func](const T &x) {func(x);});
+    }
+    std::vector<T> to_vector() const {
+        std::vector<T> ret;
+        ret.reserve(size_);
+        for_each([&ret](const T &x) {ret.push_back(x);});
+        return ret;
+    }
+    void clear() {
+        for_each([](T &x) {x.~T();});
+        while(blocks_.size() > 1) release_block(blocks_.pop_back());
+        start_ = size_ = 0;
+    }
+    size_type size()     const noexcept {return size_;}
+    bool empty()         const noexcept {return size_ == 0;}
+    size_type capacity() const noexcept {return blocks_.size() * block_size - start_;}
+    size_type blocks()   const noexcept {return blocks_.size();}
+}; // segmented_deque
+
+} // namespace circ
+
+#endif /* #ifndef CIRCULAR_QUEUE_SEGMENTED_H__ */
@@ -0,0 +1,169 @@
+#pragma once
+#ifndef CIRCULAR_QUEUE_SERIALIZE_H__
+#define CIRCULAR_QUEUE_SERIALIZE_H__
+#include "cq.h"
+#include <cerrno>
+#include <istream>
+#include <ostream>
+#include <sys/uio.h>   // For writev
+#include <unistd.h>    // For read
+
+namespace circ {
+
+// Snapshot and restore of a deque's contents.
+// Format: a serial_header, then the elements front to back. Trivially copyable elements are stored
+// as raw bytes in native byte order, written straight from the ring's (up to two) segments and read
+// back with a single read into the restored buffer. Other types go through serializer<T>.
+
+struct serial_header {
+    char     magic[4];  // "CIRQ"
+    uint32_t version;
+    uint32_t elem_size; // sizeof(T); a mismatch means the snapshot belongs to another type or build.
+    uint32_t flags;     // 1 if elements were written by serializer<T> rather than as raw bytes.
+    uint64_t size;      // Number of elements.
+    static constexpr uint32_t current_version = 1;
+    static constexpr uint32_t custom = 1;
+    template<typename T>
+    static serial_header make(uint64_t size) {
+        return serial_header{{'C', 'I', 'R', 'Q'}, current_version, uint32_t(sizeof(T)),
+                             std::is_trivially_copyable<T>::value ? 0u: custom, size};
+    }
+    template<typename T>
+    void check() const {
+        if(std::memcmp(magic, "CIRQ", 4)) throw std::runtime_error("Not a serialized circ::deque. Abort!");
+        if(version != current_version) throw std::runtime_error("Unsupported circ::deque serialization version " + std::to_string(version) + ". Abort!");
+        if(elem_size != sizeof(T) || flags != make<T>(0).flags) throw std::runtime_error("Serialized circ::deque holds a different element type. Abort!");
+    }
+};
+
+// Customization point for element types which are not trivially copyable: specialize with
+//     static void save(std::ostream &os, const T &x);
+//     static T load(std::istream &is);
+// load should throw on a truncated or malformed stream.
+template<typename T>
+struct serializer {
+    static_assert(std::is_trivially_copyable<T>::value, "Specialize circ::serializer<T> to serialize this type");
+};
+
+template<typename CharT, typename Traits, typename Alloc>
+struct serializer<std::basic_string<CharT, Traits, Alloc>> {
+    using string_type = std::basic_string<CharT, Traits, Alloc>;
+    static void save(std::ostream &os, const string_type &x) {
+        const uint64_t n = x.size();
+        os.write(reinterpret_cast<const char *>(&n), sizeof(n));
+        os.write(reinterpret_cast<const char *>(x.data()), n * sizeof(CharT));
+    }
+    static string_type load(std::istream &is) {
+        uint64_t n;
+        if(!is.read(reinterpret_cast<char *>(&n), sizeof(n))) throw std::runtime_error("Truncated serialized string. Abort!");
+        string_type ret(n, CharT());
+        if(!is.read(reinterpret_cast<char *>(&ret[0]), n * sizeof(CharT))) throw std::runtime_error("Truncated serialized string. Abort!");
+        return ret;
+    }
+};
+
+template<typename T, typename SizeType, typename Allocator, typename Stats>
+static inline T *prepare_restore(deque<T, SizeType, Allocator, Stats> &q, uint64_t n) {
+    // Empty q and make room for n elements starting at data()[0].
+    if(n >= uint64_t(SizeType(-1) >> 1)) throw std::runtime_error("Serialized circ::deque is too large for its size_type. Abort!");
+    q.clear();
+    q.reserve(SizeType(n));
+    return q.data();
+}
+
+static inline void write_fully(int fd, struct iovec *iov, int niov) {
+    while(niov) {
+        const ssize_t w = ::writev(fd, iov, niov);
+        if(w < 0) {
+            if(errno == EINTR) continue;
+            throw std::runtime_error(std::string("Failed to write serialized circ::deque: ") + std::strerror(errno) + ". Abort!");
+        }
+        // Skip what was written; a short write resumes partway through an iovec.
+        size_t done = w;
+        for(; niov && done >= iov->iov_len; done -= iov->iov_len, ++iov, --niov);
+        if(niov) iov->iov_base = static_cast<char *>(iov->iov_base) + done, iov->iov_len -= done;
+    }
+}
+
+static inline void read_fully(int fd, void *dst, size_t n) {
+    for(char *p = static_cast<char *>(dst); n;) {
+        const ssize_t r = ::read(fd, p, n);
+        if(r < 0) {
+            if(errno == EINTR) continue;
+            throw std::runtime_error(std::string("Failed to read serialized circ::deque: ") + std::strerror(errno) + ". Abort!");
+        }
+        if(r == 0) throw std::runtime_error("Truncated serialized circ::deque. Abort!");
+        p += r, n -= r;
+    }
+}
+
+// Element bodies, dispatched on std::is_trivially_copyable<T> so that only the applicable one is
+// instantiated, with or without if constexpr.
+template<typename T, typename SizeType, typename Allocator, typename Stats>
+static inline void save_elements(const deque<T, SizeType, Allocator, Stats> &q, std::ostream &os, std::true_type) {
+    T *ptrs[2];
+    SizeType lens[2];
+    for(unsigned i = 0, n = q.used_segments(ptrs, lens); i < n; ++i)
+        os.write(reinterpret_cast<const char *>(ptrs[i]), size_t(lens[i]) * sizeof(T));
+}
+template<typename T, typename SizeType, typename Allocator, typename Stats>
+static inline void save_elements(const deque<T, SizeType, Allocator, Stats> &q, std::ostream &os, std::false_type) {
+    q.for_each([&os](const T &x) {serializer<T>::save(os, x);});
+}
+template<typename T, typename SizeType, typename Allocator, typename Stats>
+static inline void load_elements(deque<T, SizeType, Allocator, Stats> &q, std::istream &is, uint64_t n, std::true_type) {
+    T *const dst = prepare_restore(q, n);
+    if(!is.read(reinterpret_cast<char *>(dst), n * sizeof(T))) throw std::runtime_error("Truncated serialized circ::deque. Abort!");
+    if(n) q.commit_back(SizeType(n));
+}
+template<typename T, typename SizeType, typename Allocator, typename Stats>
+static inline void load_elements(deque<T, SizeType, Allocator, Stats> &q, std::istream &is, uint64_t n, std::false_type) {
+    prepare_restore(q, n);
+    for(uint64_t i = 0; i < n; ++i) q.push_back(serializer<T>::load(is));
+}
+
+template<typename T, typename SizeType, typename Allocator, typename Stats>
+void serialize(const deque<T, SizeType, Allocator, Stats> &q, std::ostream &os) {
+    const serial_header h = serial_header::make<T>(q.size());
+    os.write(reinterpret_cast<const char *>(&h), sizeof(h));
+    save_elements(q, os, std::is_trivially_copyable<T>());
+    if(!os) throw std::runtime_error("Failed to write serialized circ::deque. Abort!");
+}
+
+template<typename T, typename SizeType, typename Allocator, typename Stats>
+void deserialize(deque<T, SizeType, Allocator, Stats> &q, std::istream &is) {
+    serial_header h;
+    if(!is.read(reinterpret_cast<char *>(&h), sizeof(h))) throw std::runtime_error("Truncated serialized circ::deque. Abort!");
+    h.check<T>();
+    load_elements(q, is, h.size, std::is_trivially_copyable<T>());
+}
+
+// Descriptor versions, for trivially copyable T: one writev for the header and both segments,
+// and one read (barring short reads) straight into the restored buffer.
+template<typename T, typename SizeType, typename Allocator, typename Stats>
+void serialize(const deque<T, SizeType, Allocator, Stats> &q, int fd) {
+    static_assert(std::is_trivially_copyable<T>::value, "Serialize other types through a std::ostream");
+    const serial_header h = serial_header::make<T>(q.size());
+    T *ptrs[2];
+    SizeType lens[2];
+    const unsigned n = q.used_segments(ptrs, lens);
+    struct iovec iov[3];
+    iov[0].iov_base = const_cast<serial_header *>(&h);
+    iov[0].iov_len = sizeof(h);
+    for(unsigned i = 0; i < n; ++i) iov[i + 1].iov_base = ptrs[i], iov[i + 1].iov_len = size_t(lens[i]) * sizeof(T);
+    write_fully(fd, iov, n + 1);
+}
+
+template<typename T, typename SizeType, typename Allocator, typename Stats>
+void deserialize(deque<T, SizeType, Allocator, Stats> &q, int fd) {
+    static_assert(std::is_trivially_copyable<T>::value, "Deserialize other types through a std::istream");
+    serial_header h;
+    read_fully(fd, &h, sizeof(h));
+    h.check<T>();
+    read_fully(fd, prepare_restore(q, h.size), h.size * sizeof(T));
+    if(h.size) q.commit_back(SizeType(h.size)); // An empty snapshot pushed nothing, so Stats should not see a push.
+}
+
+} // namespace circ
+
+#endif /* #ifndef CIRCULAR_QUEUE_SERIALIZE_H__ */
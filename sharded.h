@@ -0,0 +1,101 @@
+#pragma once
+#ifndef CIRCULAR_QUEUE_SHARDED_H__
+#define CIRCULAR_QUEUE_SHARDED_H__
+#include "cq.h"
+#include "spinlock.h"  // For circ::spinlock
+#include <mutex>       // For std::lock_guard
+
+namespace circ {
+
+template<typename T, typename SizeType=uint32_t>
+class sharded_queue {
+    // A concurrent queue split into one circ::deque per thread, each behind its own lock on its own cache line.
+    // Threads push to and pop from their home shard, so in the common case no two threads touch the same line.
+    // A thread whose shard is empty steals half of the first non-empty shard it finds.
+    // Order is FIFO within a shard only.
+    struct alignas(CIRC_CACHELINE_SIZE) shard {
+        mutable spinlock       lock_;
+        deque<T, SizeType>     queue_;
+    };
+    unsigned                 nshards_;
+    aligned_array<shard>     shards_;   // new shard[] is only cache-line aligned from C++17 on.
+
+    bool steal(unsigned thief, T &out) {
+        for(unsigned i = 1; i < nshards_; ++i) {
+            const unsigned victim = (thief + i) % nshards_;
+            shard &v = shards_[victim], &t = shards_[thief];
+            // Always lock the lower index first so two thieves can't deadlock.
+            std::unique_lock<spinlock> first(victim < thief ? v.lock_: t.lock_),
+                                       second(victim < thief ? t.lock_: v.lock_);
+            size_type n = v.queue_.size();
+            if(n == 0) continue;
+            // Make room first: once elements leave the victim, pushing them must not throw.
+            t.queue_.reserve(t.queue_.size() + (n >> 1));
+            out = v.queue_.pop();
+            for(n >>= 1; n; --n) t.queue_.push_back(v.queue_.pop());
+            return true;
+        }
+        return false;
+    }
+
+public:
+    using size_type = SizeType;
+    sharded_queue(unsigned nshards=0, SizeType size=63):
+        nshards_(nshards ? nshards: std::max(1u, std::thread::hardware_concurrency())),
+        shards_(nshards_)
+    {
+        for(unsigned i = 0; i < nshards_; ++i)
+            if(size > shards_[i].queue_.capacity()) shards_[i].queue_.resize(size + 1);
+    }
+    sharded_queue(const sharded_queue &) = delete;
+    sharded_queue &operator=(const sharded_queue &) = delete;
+    // The calling thread's shard. Threads are assigned round-robin on first use.
+    unsigned home() const {
+        static std::atomic<unsigned> next(0);
+        thread_local unsigned id = next.fetch_add(1, std::memory_order_relaxed);
+        return id % nshards_;
+    }
+    template<typename... Args>
+    void push_to(unsigned shard_id, Args &&... args) {
+        shard &s = shards_[shard_id];
+        std::lock_guard<spinlock> lock(s.lock_);
+        s.queue_.push_back(std::forward<Args>(args)...);
+    }
+    template<typename... Args>
+    void push(Args &&... args) {
+        push_to(home(), std::forward<Args>(args)...);
+    }
+    template<typename... Args>
+    void push_back(Args &&... args) {
+        push(std::forward<Args>(args)...); // Interface compatibility
+    }
+    // Pops from shard_id only; does not steal.
+    bool try_pop_from(unsigned shard_id, T &out) {
+        shard &s = shards_[shard_id];
+        std::lock_guard<spinlock> lock(s.lock_);
+        if(s.queue_.size() == 0) return false;
+        out = s.queue_.pop();
+        return true;
+    }
+    // Pops from the calling thread's shard, stealing from the others if it is empty.
+    bool try_pop(T &out) {
+        const unsigned id = home();
+        return try_pop_from(id, out) || steal(id, out);
+    }
+    size_t shard_size(unsigned shard_id) const {
+        const shard &s = shards_[shard_id];
+        std::lock_guard<spinlock> lock(s.lock_);
+        return s.queue_.size();
+    }
+    // Not a snapshot: shards are visited one at a time.
+    size_t size() const {
+        size_t ret = 0;
+        for(unsigned i = 0; i < nshards_; ret += shard_size(i++));
+        return ret;
+    }
+    unsigned shards() const noexcept {return nshards_;}
+}; // sharded_queue
+
+} // namespace circ
+
+#endif /* #ifndef CIRCULAR_QUEUE_SHARDED_H__ */
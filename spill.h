@@ -0,0 +1,172 @@
+#pragma once
+#ifndef CIRCULAR_QUEUE_SPILL_H__
+#define CIRCULAR_QUEUE_SPILL_H__
+#include "cq.h"
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/uio.h>   // For pwritev
+#include <unistd.h>
+
+namespace circ {
+
+template<typename T, size_t BlockSize=65536, typename SizeType=uint32_t>
+class spill_deque {
+    // A FIFO whose memory stays bounded however far the consumer falls behind.
+    // Elements live in three tiers, front to back: head_ in memory, then blocks of BlockSize elements
+    // in an unlinked temporary file, then hot_ in memory. While more than max_in_memory elements are
+    // in RAM, push_back writes the oldest block of hot_ to the end of the file with one pwritev
+    // of its (up to two) segments; pop reads the next block back with one pread once head_ runs dry,
+    // hinting the kernel to prefetch the one after. Disk traffic is therefore sequential and in
+    // large blocks, and only about max_in_memory + 2 * BlockSize elements are ever resident.
+    // File space is released as blocks are read back: by hole punching where supported, and by
+    // truncation whenever the file empties.
+    static_assert(std::is_trivially_copyable<T>::value, "Spilled elements are written as bytes");
+    static constexpr size_t block_bytes = BlockSize * sizeof(T);
+    deque<T, SizeType> head_;
+    deque<T, SizeType> hot_;
+    size_t             max_in_memory_;
+    int                fd_;
+    uint64_t           read_off_;  // File offset of the oldest spilled block.
+    uint64_t           write_off_; // File offset past the newest.
+
+    [[noreturn]] static void fail(const char *what) {
+        throw std::runtime_error(std::string("spill_deque: ") + what + ": " + std::strerror(errno) + ". Abort!");
+    }
+    size_t disk_blocks() const {return (write_off_ - read_off_) / block_bytes;}
+    void spill() {
+        T *ptrs[2];
+        SizeType lens[2];
+        const unsigned n = hot_.used_segments(ptrs, lens);
+        struct iovec iov[2];
+        int niov = 0;
+        for(size_t left = BlockSize; niov < int(n) && left; ++niov) {
+            iov[niov].iov_base = ptrs[niov];
+            iov[niov].iov_len = std::min(size_t(lens[niov]), left) * sizeof(T);
+            left -= iov[niov].iov_len / sizeof(T);
+        }
+        for(size_t done = 0; done < block_bytes;) {
+            const ssize_t w = ::pwritev(fd_, iov, niov, write_off_ + done);
+            if(w < 0) {
+                if(errno == EINTR) continue;
+                fail("write");
+            }
+            done += w;
+            size_t skip = w;
+            int first = 0;
+            for(; first < niov && skip >= iov[first].iov_len; skip -= iov[first++].iov_len);
+            std::memmove(iov, iov + first, (niov - first) * sizeof(*iov));
+            niov -= first;
+            if(niov) iov[0].iov_base = static_cast<char *>(iov[0].iov_base) + skip, iov[0].iov_len -= skip;
+        }
+        write_off_ += block_bytes;
+        hot_.discard_front(SizeType(BlockSize));
+    }
+    // Read one block at off into q, which must be empty.
+    void load(uint64_t off, deque<T, SizeType> &q) {
+        q.clear(); // start_ at 0, so the free space is contiguous.
+        T *ptrs[2] = {}; // free_segments always fills ptrs[0] here; this quiets -Wmaybe-uninitialized.
+        SizeType lens[2];
+        q.free_segments(ptrs, lens);
+        assert(lens[0] >= BlockSize);
+        char *dst = reinterpret_cast<char *>(ptrs[0]);
+        for(size_t done = 0; done < block_bytes;) {
+            const ssize_t r = ::pread(fd_, dst + done, block_bytes - done, off + done);
+            if(r < 0) {
+                if(errno == EINTR) continue;
+                fail("read");
+            }
+            if(r == 0) throw std::runtime_error("spill_deque: spill file truncated. Abort!");
+            done += r;
+        }
+        q.commit_back(SizeType(BlockSize));
+    }
+    void release(uint64_t off) {
+        // Give back disk space for a block which has been read back.
+        if(read_off_ == write_off_) {
+            read_off_ = write_off_ = 0;
+            if(::ftruncate(fd_, 0)) fail("truncate");
+            return;
+        }
+#if defined(__linux__) && defined(FALLOC_FL_PUNCH_HOLE)
+        ::fallocate(fd_, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, off, block_bytes); // Best effort.
+#else
+        (void)off;
+#endif
+    }
+
+    void fill_head() {
+        if(head_.size() || read_off_ == write_off_) return;
+        const uint64_t off = read_off_;
+        load(off, head_);
+        read_off_ += block_bytes;
+#ifdef POSIX_FADV_WILLNEED
+        if(read_off_ != write_off_) ::posix_fadvise(fd_, read_off_, block_bytes, POSIX_FADV_WILLNEED);
+#endif
+        release(off);
+    }
+    void fill_hot() {
+        if(hot_.size() || read_off_ == write_off_) return;
+        write_off_ -= block_bytes;
+        load(write_off_, hot_);
+        release(write_off_);
+    }
+
+public:
+    using size_type = size_t;
+    using value_type = T;
+    // Spill once more than max_in_memory elements would be held in RAM. The file is created in dir
+    // and unlinked immediately, so it disappears with the process.
+    spill_deque(size_t max_in_memory, const char *dir="/tmp"):
+        head_(SizeType(BlockSize)), hot_(SizeType(2 * BlockSize - 1)),
+        max_in_memory_(std::max(max_in_memory, 2 * BlockSize)), fd_(-1), read_off_(0), write_off_(0)
+    {
+        std::string path = std::string(dir) + "/circ_spill.XXXXXX";
+        if((fd_ = ::mkstemp(&path[0])) < 0) fail("create spill file");
+        ::unlink(path.c_str());
+    }
+    spill_deque(const spill_deque &) = delete;
+    spill_deque &operator=(const spill_deque &) = delete;
+    ~spill_deque() {if(fd_ >= 0) ::close(fd_);}
+    template<typename... Args>
+    T &push_back(Args &&... args) {
+        if(__builtin_expect(hot_.size() >= 2 * BlockSize - 1, 0) && size_t(head_.size()) + hot_.size() >= max_in_memory_) spill();
+        return hot_.push_back(std::forward<Args>(args)...);
+    }
+    template<typename... Args>
+    T &emplace_back(Args &&... args) {
+        return push_back(std::forward<Args>(args)...); // Interface compatibility.
+    }
+    template<typename... Args>
+    T &push(Args &&... args) {
+        return push_back(std::forward<Args>(args)...); // Interface compatibility
+    }
+    T pop() {
+        fill_head();
+        return head_.size() ? head_.pop(): hot_.pop();
+    }
+    T pop_front() {
+        return pop(); // Interface compatibility with std::list.
+    }
+    T pop_back() {
+        fill_hot();
+        return hot_.size() ? hot_.pop_back(): head_.pop_back();
+    }
+    // May read a block back from disk, hence not const.
+    T &front() {
+        fill_head();
+        return head_.size() ? head_.front(): hot_.front();
+    }
+    T &back() {
+        fill_hot();
+        return hot_.size() ? hot_.back(): head_.back();
+    }
+    size_t size()        const noexcept {return size_t(head_.size()) + disk_blocks() * BlockSize + hot_.size();}
+    bool empty()         const noexcept {return size() == 0;}
+    size_t in_memory()   const noexcept {return size_t(head_.size()) + hot_.size();}
+    size_t spilled()     const noexcept {return disk_blocks() * BlockSize;}
+    uint64_t file_size() const noexcept {return write_off_;}
+}; // spill_deque
+
+} // namespace circ
+
+#endif /* #ifndef CIRCULAR_QUEUE_SPILL_H__ */
@@ -0,0 +1,43 @@
+#pragma once
+#ifndef CIRCULAR_QUEUE_SPINLOCK_H__
+#define CIRCULAR_QUEUE_SPINLOCK_H__
+#include <atomic>      // For std::atomic
+#include <thread>      // For std::this_thread::yield
+
+namespace circ {
+
+class backoff {
+    // Spin briefly, then start yielding the core.
+    unsigned spins_ = 0;
+public:
+    void operator()() {
+        if(spins_ < 64) {
+            ++spins_;
+#if defined(__x86_64__) || defined(__i386__)
+            __builtin_ia32_pause();
+#endif
+        } else std::this_thread::yield();
+    }
+    void reset() {spins_ = 0;}
+};
+
+class spinlock {
+    // Test-and-test-and-set lock for critical sections a few instructions long.
+    // Satisfies Lockable, so it works with std::lock_guard and std::unique_lock.
+    std::atomic<bool> locked_;
+public:
+    spinlock(): locked_(false) {}
+    spinlock(const spinlock &) = delete;
+    spinlock &operator=(const spinlock &) = delete;
+    bool try_lock() {
+        return !locked_.load(std::memory_order_relaxed) && !locked_.exchange(true, std::memory_order_acquire);
+    }
+    void lock() {
+        for(backoff wait; !try_lock(); wait());
+    }
+    void unlock() {locked_.store(false, std::memory_order_release);}
+};
+
+} // namespace circ
+
+#endif /* #ifndef CIRCULAR_QUEUE_SPINLOCK_H__ */
@@ -0,0 +1,149 @@
+// Multi-threaded checks of the concurrent queues; run under ThreadSanitizer by `make -C tests tsan`.
+#include "test.h"
+#include "broadcast.h"
+#include "intrusive.h"
+#include "multicast.h"
+#include "sharded.h"
+#include <atomic>
+#include <thread>
+#include <vector>
+
+CIRC_TEST(concurrent_multicast) {
+    // Consumer 1 follows consumer 0, so it must never see an element 0 hasn't released.
+    const uint64_t n = 200000;
+    circ::multicast_ring<uint64_t> ring(64, 2);
+    ring.follow(1, 0);
+    uint64_t sum0 = 0, sum1 = 0;
+    bool ok0 = true, ok1 = true;
+    std::thread c0([&] {
+        uint64_t expect = 0;
+        while(expect < n)
+            ring.consume(0, [&](uint64_t x) {ok0 &= x == expect++; sum0 += x;});
+    });
+    std::thread c1([&] {
+        uint64_t expect = 0;
+        while(expect < n)
+            ring.consume(1, [&](uint64_t x) {
+                ok1 &= x == expect++ && ring.sequence(0) >= expect;
+                sum1 += x;
+            });
+    });
+    for(uint64_t i = 0; i < n; ++i) ring.push(i);
+    c0.join();
+    c1.join();
+    CIRC_CHECK(ok0 && ok1);
+    CIRC_CHECK(sum0 == n * (n - 1) / 2 && sum1 == sum0);
+}
+
+template<typename Func>
+static bool throws(const Func &func) {
+    try {func();} catch(const std::runtime_error &) {return true;}
+    return false;
+}
+
+CIRC_TEST(multicast_setup) {
+    CIRC_CHECK(throws([] {circ::multicast_ring<int> ring(8, 0);}));
+    circ::multicast_ring<int> ring(8, 3);
+    ring.follow(1, 0);
+    ring.follow(2, 1);
+    CIRC_CHECK(throws([&] {ring.follow(0, 2);})); // 0 -> 2 -> 1 -> 0
+    CIRC_CHECK(throws([&] {ring.follow(1, 1);}));
+    CIRC_CHECK(throws([&] {ring.follow(3, 0);}));
+    ring.push(1);
+    CIRC_CHECK(throws([&] {ring.follow(2, 0);})); // Too late: elements are in flight.
+    int seen = 0;
+    CIRC_CHECK(ring.available(2) == 0 && ring.try_consume(0, [&](int x) {seen += x;}) == 1);
+    CIRC_CHECK(ring.try_consume(1, [&](int x) {seen += x;}) == 1 && ring.try_consume(2, [&](int x) {seen += x;}) == 1);
+    CIRC_CHECK(seen == 3);
+}
+
+CIRC_TEST(concurrent_broadcast) {
+    // Readers may be lapped, but what they read is never torn and always in order.
+    struct pair {uint64_t a, b;};
+    const uint64_t n = 200000;
+    circ::broadcast_ring<pair> ring(256);
+    std::atomic<bool> done(false);
+    bool ok = true;
+    uint64_t got = 0;
+    std::thread reader([&] {
+        auto r = ring.subscribe_oldest();
+        const uint64_t first = r.position();
+        uint64_t last = 0;
+        pair p;
+        for(;;) {
+            const bool finished = done.load(std::memory_order_acquire);
+            while(r.try_read(p)) {
+                ok &= p.b == ~p.a && (got == 0 || p.a > last);
+                last = p.a;
+                ++got;
+            }
+            if(finished) break;
+        }
+        ok &= r.position() == n && first + got + r.dropped() == n;
+    });
+    for(uint64_t i = 0; i < n; ++i) ring.push(pair{i, ~i});
+    done.store(true, std::memory_order_release);
+    reader.join();
+    CIRC_CHECK(ok);
+}
+
+CIRC_TEST(concurrent_sharded) {
+    // Every element is popped exactly once, with stealing between shards.
+    const unsigned nthreads = 4, per = 50000;
+    circ::sharded_queue<uint32_t> q(nthreads);
+    std::vector<std::atomic<uint8_t>> seen(nthreads * per);
+    for(auto &s: seen) s.store(0);
+    std::atomic<unsigned> popped(0);
+    std::vector<std::thread> threads;
+    for(unsigned t = 0; t < nthreads; ++t)
+        threads.emplace_back([&, t] {
+            uint32_t x;
+            for(unsigned i = 0; i < per; ++i) {
+                q.push(t * per + i);
+                if(i % 2 && q.try_pop(x)) seen[x].fetch_add(1), popped.fetch_add(1);
+            }
+            while(popped.load() < nthreads * per)
+                if(q.try_pop(x)) seen[x].fetch_add(1), popped.fetch_add(1);
+        });
+    for(auto &t: threads) t.join();
+    for(auto &s: seen) CIRC_CHECK(s.load() == 1);
+    CIRC_CHECK(q.size() == 0);
+}
+
+CIRC_TEST(concurrent_pointer_ring) {
+    // The owner pushes and pops while another thread cancels: each element is taken exactly once.
+    struct alignas(8) job {unsigned id;};
+    const unsigned n = 100000;
+    std::vector<job> jobs(n);
+    for(unsigned i = 0; i < n; ++i) jobs[i].id = i;
+    std::vector<std::atomic<uint8_t>> taken(n);
+    for(auto &t: taken) t.store(0);
+    std::vector<uint64_t> pos(n);
+    std::atomic<unsigned> published(0);
+    circ::pointer_ring<job> ring;
+    ring.reserve(n);
+    std::thread canceller([&] {
+        uint64_t x = 88172645463325252ull;
+        for(unsigned k = 0; k < 2 * n; ++k) {
+            const unsigned limit = published.load(std::memory_order_acquire);
+            if(!limit) continue;
+            x ^= x << 13, x ^= x >> 7, x ^= x << 17;
+            const unsigned i = unsigned(x % limit);
+            if(ring.cancel(pos[i], &jobs[i])) taken[i].fetch_add(1);
+        }
+    });
+    for(unsigned i = 0; i < n; ++i) {
+        pos[i] = ring.push(&jobs[i], i & 7);
+        published.store(i + 1, std::memory_order_release);
+        if(i % 3 == 0)
+            if(job *j = ring.pop()) taken[j->id].fetch_add(1);
+    }
+    canceller.join();
+    unsigned tag;
+    while(job *j = ring.pop(tag)) {
+        CIRC_CHECK(tag == (j->id & 7));
+        taken[j->id].fetch_add(1);
+    }
+    for(auto &t: taken) CIRC_CHECK(t.load() == 1);
+    CIRC_CHECK(ring.size() == 0 && ring.tombstones() == 0);
+}
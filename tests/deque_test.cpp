@@ -0,0 +1,315 @@
+// Differential tests of circ::deque and its variants (segmented, compact, incremental) against std::deque.
+#include "test.h"
+#include "cq.h"
+#include "segmented.h"
+#include "compact.h"
+#include "incremental.h"
+#include "alloc.h"
+#include <deque>
+#include <random>
+#include <string>
+
+namespace {
+
+template<typename Q, typename T>
+void check_equal(const Q &q, const std::deque<T> &ref) {
+    CIRC_CHECK(size_t(q.size()) == ref.size());
+    for(size_t i = 0; i < ref.size(); ++i) CIRC_CHECK(q[i] == ref[i]);
+}
+
+template<typename T, typename SizeType, typename Make>
+void fuzz_deque(unsigned seed, const Make &make) {
+    std::mt19937 rng(seed);
+    circ::deque<T, SizeType> q;
+    std::deque<T> ref;
+    for(int it = 0; it < 50000; ++it) {
+        if(ref.size() > 200) q.shrink_to_fit();
+        const size_t sz = ref.size();
+        switch(rng() % 12) {
+            case 0: case 1: {T v(make(it)); q.push_back(v); ref.push_back(v); break;}
+            case 2: case 3: {T v(make(it)); q.push_front(v); ref.push_front(v); break;}
+            case 4: if(sz) {CIRC_CHECK(q.pop() == ref.front()); ref.pop_front();} break;
+            case 5: if(sz) {CIRC_CHECK(q.pop_back() == ref.back()); ref.pop_back();} break;
+            case 6: {
+                const size_t i = rng() % (sz + 1);
+                T v(make(it));
+                CIRC_CHECK(*q.insert(q.begin() + i, v) == v);
+                ref.insert(ref.begin() + i, v);
+                break;
+            }
+            case 7: if(sz) {
+                const size_t i = rng() % sz, n = rng() % std::min<size_t>(sz - i + 1, 8);
+                q.erase(q.begin() + i, q.begin() + i + n);
+                ref.erase(ref.begin() + i, ref.begin() + i + n);
+            } break;
+            case 8: {
+                const size_t i = rng() % (sz + 1), n = rng() % 6 + 1;
+                std::vector<T> src;
+                for(size_t k = 0; k < n; ++k) src.push_back(make(it * 8 + int(k)));
+                q.insert(q.begin() + i, src.begin(), src.end());
+                ref.insert(ref.begin() + i, src.begin(), src.end());
+                break;
+            }
+            case 9: if(rng() % 16 == 0) {
+                const unsigned m = rng() % 4 + 2;
+                auto pred = [m](const T &x) {return std::hash<T>()(x) % m == 0;};
+                const size_t before = ref.size();
+                ref.erase(std::remove_if(ref.begin(), ref.end(), pred), ref.end());
+                CIRC_CHECK(size_t(q.erase_if(pred)) == before - ref.size());
+            } break;
+            case 10: while(ref.size() > 100) {q.pop(); ref.pop_front();} break;
+            case 11: if(rng() % 64 == 0) {
+                circ::deque<T, SizeType> copy(q), moved(std::move(q));
+                check_equal(copy, ref);
+                q = std::move(moved);
+            } break;
+        }
+        if(it % 61 == 0) check_equal(q, ref);
+    }
+    check_equal(q, ref);
+}
+
+// The operations the deque variants share: both ends, indexing, for_each and clear.
+template<typename Q, typename T, typename Make>
+void fuzz_ends(Q &q, unsigned seed, const Make &make) {
+    std::mt19937 rng(seed);
+    std::deque<T> ref;
+    for(int it = 0; it < 30000; ++it) {
+        const size_t sz = ref.size();
+        switch(rng() % 9) {
+            case 0: case 1: {T v(make(it)); q.push_back(v); ref.push_back(v); break;}
+            case 2: {T v(make(it)); q.push_front(v); ref.push_front(v); break;}
+            case 3: case 4: if(sz) {CIRC_CHECK(q.front() == ref.front() && q.pop() == ref.front()); ref.pop_front();} break;
+            case 5: if(sz) {CIRC_CHECK(q.back() == ref.back() && q.pop_back() == ref.back()); ref.pop_back();} break;
+            case 6: if(sz) {const size_t i = rng() % sz; CIRC_CHECK(q[i] == ref[i]);} break;
+            case 7: if(rng() % 512 == 0) {q.clear(); ref.clear();} break;
+            case 8: if(rng() % 64 == 0) {
+                size_t i = 0;
+                bool same = true;
+                q.for_each([&](const T &x) {same &= i < ref.size() && x == ref[i++];});
+                CIRC_CHECK(same && i == ref.size());
+            } break;
+        }
+        if(it % 97 == 0) check_equal(q, ref);
+    }
+    check_equal(q, ref);
+}
+
+} // namespace
+
+CIRC_TEST(deque_fuzz_int) {
+    fuzz_deque<int, uint32_t>(1, [](int i) {return i;});
+    fuzz_deque<uint64_t, uint16_t>(2, [](int i) {return uint64_t(i) * 0x9e3779b97f4a7c15ull;});
+}
+
+CIRC_TEST(deque_fuzz_string) {
+    fuzz_deque<std::string, uint32_t>(3, [](int i) {return std::string(24, char('a' + (i & 15))) + std::to_string(i);});
+}
+
+template<typename T, typename Make>
+static void erase_if_counting(const Make &make) {
+    // A stateful predicate, "drop the first three odd elements", sees each element exactly once.
+    for(int offset = 0; offset < 40; offset += 7) {
+        circ::deque<T> q(31);
+        std::deque<T> ref;
+        for(int i = 0; i < offset; ++i) q.push_back(make(0)), q.pop(); // Wrap the ring at different points.
+        for(int i = 0; i < 30; ++i) q.push_back(make(i)), ref.push_back(make(i));
+        size_t calls = 0, refcalls = 0;
+        int qdrop = 3, refdrop = 3;
+        CIRC_CHECK(q.erase_if([&](const T &x) {++calls; return (std::hash<T>()(x) & 1) && qdrop-- > 0;}) == 3);
+        ref.erase(std::remove_if(ref.begin(), ref.end(), [&](const T &x) {++refcalls; return (std::hash<T>()(x) & 1) && refdrop-- > 0;}), ref.end());
+        CIRC_CHECK(calls == 30 && refcalls == 30);
+        check_equal(q, ref);
+    }
+}
+
+CIRC_TEST(deque_erase_if_counting) {
+    erase_if_counting<int>([](int i) {return i;});
+    erase_if_counting<std::string>([](int i) {return std::to_string(i);});
+}
+
+struct flaky {
+    // Copies throw once the countdown runs out.
+    static int countdown;
+    std::string s;
+    flaky(std::string x): s(std::move(x)) {}
+    flaky(const flaky &o): s(o.s) {if(countdown-- == 0) throw std::runtime_error("flaky copy");}
+    flaky(flaky &&o) noexcept: s(std::move(o.s)) {}
+};
+int flaky::countdown = -1;
+
+CIRC_TEST(deque_insert_range_throws) {
+    // A copy failing partway through a range insert leaves the deque as it was.
+    for(unsigned offset = 0; offset < 16; offset += 5) {
+        for(size_t at = 0; at <= 10; at += 3) {
+            circ::deque<flaky> q(15);
+            for(unsigned k = 0; k < offset; ++k) q.push_back(flaky("x")), q.pop();
+            for(int k = 0; k < 10; ++k) q.push_back(flaky(std::to_string(k)));
+            std::vector<flaky> src;
+            for(int k = 0; k < 4; ++k) src.push_back(flaky("new" + std::to_string(k)));
+            flaky::countdown = 2;
+            bool threw = false;
+            try {q.insert(q.begin() + at, src.begin(), src.end());} catch(const std::runtime_error &) {threw = true;}
+            flaky::countdown = -1;
+            CIRC_CHECK(threw && q.size() == 10);
+            for(int k = 0; k < 10; ++k) CIRC_CHECK(q[k].s == std::to_string(k));
+        }
+    }
+}
+
+CIRC_TEST(deque_auto_shrink) {
+    circ::deque<int> q;
+    q.auto_shrink(16);
+    for(int i = 0; i < 4096; ++i) q.push_back(i);
+    for(int i = 0; i < 4090; ++i) CIRC_CHECK(q.pop() == i);
+    CIRC_CHECK(q.capacity() < 64);
+    for(int i = 0; i < 6; ++i) CIRC_CHECK(q[i] == 4090 + i);
+}
+
+struct failing_allocator: circ::malloc_allocator {
+    // Fails every allocation once armed.
+    static bool armed;
+    void *allocate(size_t nbytes) {return armed ? nullptr: std::malloc(nbytes);}
+};
+bool failing_allocator::armed = false;
+
+CIRC_TEST(deque_auto_shrink_out_of_memory) {
+    // A shrink that cannot allocate leaves the deque as it was and the pop still returns its element.
+    circ::deque<std::string, uint32_t, failing_allocator> q;
+    q.auto_shrink(4);
+    for(int i = 0; i < 256; ++i) q.push_back(std::to_string(i));
+    const auto cap = q.capacity();
+    failing_allocator::armed = true;
+    for(int i = 0; i < 250; ++i) CIRC_CHECK(q.pop() == std::to_string(i));
+    failing_allocator::armed = false;
+    CIRC_CHECK(q.capacity() == cap && q.size() == 6 && q[5] == "255");
+    q.pop();
+    CIRC_CHECK(q.capacity() < cap && q[0] == "251");
+}
+
+CIRC_TEST(deque_move_keeps_allocator) {
+    // Small min_bytes so every buffer is mapped: a moved-from deque must still allocate through its policy.
+    using numa_deque = circ::deque<uint64_t, uint32_t, circ::numa_allocator>;
+    numa_deque q(3, circ::numa_allocator(-1, false, false, 4096));
+    for(uint64_t i = 0; i < 2000; ++i) q.push_back(i);
+    numa_deque r(std::move(q));
+    CIRC_CHECK(q.size() == 0 && r.size() == 2000 && r[1999] == 1999);
+    for(uint64_t i = 0; i < 2000; ++i) q.push_back(i * 2);
+    CIRC_CHECK(q.size() == 2000 && q[1999] == 3998);
+    numa_deque t;
+    t.push_back(5);
+    t = std::move(q);
+    CIRC_CHECK(t.size() == 2000 && t[1000] == 2000 && q.size() == 0);
+    q.push_back(1);
+    CIRC_CHECK(q.pop() == 1);
+
+    circ::deque<std::string, uint32_t, circ::malloc_allocator, circ::op_stats> s;
+    s.push_back("a"), s.push_back("b");
+    auto u(std::move(s));
+    CIRC_CHECK(u.stats().pushes == 2 && s.stats().pushes == 0 && u[1] == "b");
+    s.push_back("c");
+    u = std::move(s);
+    CIRC_CHECK(u.size() == 1 && u[0] == "c" && u.stats().pushes == 1 && s.size() == 0);
+}
+
+CIRC_TEST(deque_op_stats) {
+    circ::deque<int, uint32_t, circ::malloc_allocator, circ::op_stats> q;
+    q.commit_back(0); // Empty commit on an empty deque: size 0 has no occupancy bucket.
+    for(int i = 0; i < 5; ++i) q.push_back(i);
+    q.pop();
+    const circ::op_stats s = q.stats();
+    CIRC_CHECK(s.pushes == 6 && s.pops == 1 && s.high_water == 5);
+    CIRC_CHECK(s.occupancy[0] == 1 && s.occupancy[1] == 2 && s.occupancy[2] == 2);
+}
+
+CIRC_TEST(segmented_fuzz) {
+    std::mt19937 rng(4);
+    circ::segmented_deque<std::string, uint32_t, 3> q;
+    std::deque<std::string> ref;
+    for(int it = 0; it < 50000; ++it) {
+        const std::string v = std::to_string(it) + std::string(20, 'x');
+        switch(rng() % 6) {
+            case 0: case 1: q.push_back(v); ref.push_back(v); break;
+            case 2: q.push_front(v); ref.push_front(v); break;
+            case 3: if(ref.size()) {CIRC_CHECK(q.pop() == ref.front()); ref.pop_front();} break;
+            case 4: if(ref.size()) {CIRC_CHECK(q.pop_back() == ref.back()); ref.pop_back();} break;
+            case 5: if(ref.size() > 300) {q.clear(); ref.clear();} break;
+        }
+        if(it % 53 == 0) check_equal(q, ref);
+    }
+    // References stay valid as the queue grows.
+    circ::segmented_deque<int> s;
+    int *first = &s.push_back(42);
+    for(int i = 0; i < 100000; ++i) s.push_back(i);
+    CIRC_CHECK(first == &s.front() && *first == 42);
+}
+
+CIRC_TEST(segmented_push_failures) {
+    // A constructor or allocation failing at a block boundary leaves the deque as it was, leaking nothing.
+    circ::segmented_deque<flaky, uint32_t, 2> q;
+    for(int k = 0; k < 10; ++k) q.push_back(flaky(std::to_string(k)));
+    const flaky extra("extra");
+    flaky::countdown = 0;
+    bool threw = false;
+    try {q.push_front(extra);} catch(const std::runtime_error &) {threw = true;}
+    flaky::countdown = -1;
+    CIRC_CHECK(threw && q.size() == 10 && q.front().s == "0" && q[9].s == "9");
+    q.push_front(extra);
+    CIRC_CHECK(q.front().s == "extra" && q[1].s == "0");
+
+    circ::segmented_deque<int, uint32_t, 2, failing_allocator> r;
+    for(int k = 0; k < 64; ++k) r.push_back(k);
+    failing_allocator::armed = true;
+    threw = false;
+    try {r.push_front(-1);} catch(const std::bad_alloc &) {threw = true;}
+    CIRC_CHECK(threw);
+    threw = false;
+    try {r.push_back(64);} catch(const std::bad_alloc &) {threw = true;}
+    failing_allocator::armed = false;
+    CIRC_CHECK(threw && r.size() == 64 && r.front() == 0 && r[63] == 63);
+}
+
+CIRC_TEST(compact_deque_fuzz) {
+    circ::compact_deque<uint64_t> a;
+    fuzz_ends<circ::compact_deque<uint64_t>, uint64_t>(a, 11, [](int i) {return uint64_t(i) * 7;});
+    circ::compact_deque<std::string, uint32_t, std::ratio<5, 4>> b(5);
+    fuzz_ends<circ::compact_deque<std::string, uint32_t, std::ratio<5, 4>>, std::string>(b, 12, [](int i) {return std::string(20, 'c') + std::to_string(i);});
+}
+
+CIRC_TEST(compact_deque_capacity_limit) {
+    // Capacity stays below half of SizeType's range, however it is requested.
+    const auto throws = [](auto func) {
+        try {func();} catch(const std::runtime_error &) {return true;}
+        return false;
+    };
+    CIRC_CHECK(throws([] {circ::compact_deque<int, uint8_t> q(200);}));
+    circ::compact_deque<int, uint8_t> q(100);
+    CIRC_CHECK(throws([&] {q.reserve(128);}));
+    q.reserve(127);
+    CIRC_CHECK(q.capacity() == 127);
+    for(int i = 0; i < 127; ++i) q.push_back(i);
+    CIRC_CHECK(throws([&] {q.push_back(0);}));
+    CIRC_CHECK(q.size() == 127 && q[126] == 126);
+}
+
+CIRC_TEST(incremental_deque_fuzz) {
+    // Growth is frequent from a small start, so most checks happen with a migration in progress.
+    circ::incremental_deque<uint64_t> a;
+    fuzz_ends<circ::incremental_deque<uint64_t>, uint64_t>(a, 13, [](int i) {return uint64_t(i) * 3;});
+    circ::incremental_deque<std::string, uint32_t, 2> b;
+    fuzz_ends<circ::incremental_deque<std::string, uint32_t, 2>, std::string>(b, 14, [](int i) {return std::string(18, 'i') + std::to_string(i);});
+
+    circ::incremental_deque<int> c;
+    std::deque<int> ref;
+    bool migrated = false;
+    for(int i = 0; i < 5000; ++i) {
+        c.push_back(i), ref.push_back(i);
+        if(i % 3 == 0) c.push_front(-i), ref.push_front(-i);
+        migrated |= c.migrating();
+        if(i % 101 == 0) check_equal(c, ref);
+    }
+    CIRC_CHECK(migrated);
+    c.reserve(20000);
+    CIRC_CHECK(!c.migrating() && c.capacity() >= 20000);
+    check_equal(c, ref);
+}
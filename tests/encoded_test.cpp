@@ -0,0 +1,165 @@
+// delta_deque and tiered_deque against std::deque, and snapshot round trips.
+#include "test.h"
+#include "encoded.h"
+#include "serialize.h"
+#include "tiered.h"
+#include <cstdio>
+#include <deque>
+#include <random>
+#include <sstream>
+#include <string>
+
+namespace {
+
+template<typename T>
+void fuzz_delta(unsigned seed, T start, unsigned max_gap) {
+    std::mt19937 rng(seed);
+    circ::delta_deque<T, 16> q;
+    std::deque<T> ref;
+    T cur = start;
+    for(int it = 0; it < 20000; ++it) {
+        if(rng() % 3) {
+            const T gap = T(rng() % (max_gap + 1));
+            if(cur > std::numeric_limits<T>::max() - gap) break;
+            cur = T(cur + gap);
+            q.push_back(cur);
+            ref.push_back(cur);
+        } else if(ref.size()) {
+            CIRC_CHECK(q.front() == ref.front());
+            CIRC_CHECK(q.pop() == ref.front());
+            ref.pop_front();
+        }
+        if(it % 97 == 0) {
+            CIRC_CHECK(q.size() == ref.size());
+            for(size_t i = 0; i < ref.size(); ++i) CIRC_CHECK(q[i] == ref[i]);
+            const T x = ref.size() ? ref[rng() % ref.size()]: cur;
+            CIRC_CHECK(q.lower_bound(x) == size_t(std::lower_bound(ref.begin(), ref.end(), x) - ref.begin()));
+        }
+    }
+}
+
+template<typename T, typename Codec, unsigned BlockSize>
+void fuzz_tiered(unsigned seed) {
+    // Runs of pushes long enough to spill several blocks, with pops from both ends thawing them again.
+    std::mt19937 rng(seed);
+    circ::tiered_deque<T, Codec, BlockSize> q;
+    std::deque<T> ref;
+    T cur = 0;
+    for(int it = 0; it < 20000; ++it) {
+        switch(rng() % 8) {
+            case 0: case 1: case 2:
+                for(unsigned n = rng() % (3 * BlockSize); n; --n) {
+                    cur = rng() % 4 ? T(cur + T(rng() % 100) - 50): T(rng()); // Mostly small deltas, either sign.
+                    q.push_back(cur);
+                    ref.push_back(cur);
+                }
+                break;
+            case 3: case 4:
+                for(unsigned n = rng() % (2 * BlockSize); n && ref.size(); --n) {
+                    CIRC_CHECK(q.front() == ref.front());
+                    CIRC_CHECK(q.pop() == ref.front());
+                    ref.pop_front();
+                }
+                break;
+            case 5: case 6:
+                for(unsigned n = rng() % (2 * BlockSize); n && ref.size(); --n) {
+                    CIRC_CHECK(q.back() == ref.back());
+                    CIRC_CHECK(q.pop_back() == ref.back());
+                    ref.pop_back();
+                }
+                break;
+            case 7:
+                if(rng() % 16 == 0) q.clear(), ref.clear();
+                break;
+        }
+        CIRC_CHECK(q.size() == ref.size());
+        if(it % 97 == 0) {
+            const std::vector<T> v = q.to_vector();
+            CIRC_CHECK(v.size() == ref.size() && std::equal(v.begin(), v.end(), ref.begin()));
+            CIRC_CHECK(q.cold_blocks() <= ref.size() / BlockSize);
+        }
+    }
+}
+
+} // namespace
+
+CIRC_TEST(tiered_deque_fuzz) {
+    fuzz_tiered<int64_t, circ::delta_varint_codec<int64_t>, 16>(21);
+    fuzz_tiered<uint32_t, circ::delta_varint_codec<uint32_t>, 2>(22);
+    fuzz_tiered<int16_t, circ::delta_varint_codec<int16_t>, 64>(23);
+    fuzz_tiered<uint64_t, circ::raw_codec<uint64_t>, 8>(24);
+}
+
+CIRC_TEST(delta_deque_fuzz) {
+    fuzz_delta<uint64_t>(1, 0, 1000);
+    fuzz_delta<int64_t>(2, -1000000, 100);
+    fuzz_delta<uint32_t>(3, 0, 1u << 20);
+    fuzz_delta<int16_t>(4, -30000, 40);
+    fuzz_delta<uint8_t>(5, 0, 3);
+}
+
+CIRC_TEST(delta_deque_narrow_signed) {
+    // Gaps between negative narrow values must not pick up the int promotion's sign bits.
+    const int16_t v[] = {-10, -9, -5, -1, 0, 1, 2, 30, 31, 40, 41, 100, 200, 300, 1000, 30000, 30001, 30002};
+    circ::delta_deque<int16_t, 16> q;
+    for(const int16_t x: v) q.push_back(x);
+    for(size_t i = 0; i < sizeof(v) / sizeof(v[0]); ++i) CIRC_CHECK(q[i] == v[i]);
+    for(const int16_t x: v) CIRC_CHECK(q.pop() == x);
+}
+
+CIRC_TEST(delta_deque_constant_runs) {
+    // Repeated values give width-0 blocks, which store no words at all.
+    circ::delta_deque<uint64_t, 16> q;
+    std::deque<uint64_t> ref;
+    for(uint64_t i = 0; i < 200; ++i) {
+        const uint64_t v = 1000 + i / 40 * 3; // Runs of 40 equal values.
+        q.push_back(v);
+        ref.push_back(v);
+    }
+    for(size_t i = 0; i < ref.size(); ++i) CIRC_CHECK(q[i] == ref[i]);
+    CIRC_CHECK(q.lower_bound(1003) == 40);
+    while(!ref.empty()) {
+        CIRC_CHECK(q.pop() == ref.front());
+        ref.pop_front();
+    }
+}
+
+CIRC_TEST(serialize_round_trip) {
+    circ::deque<uint32_t> q;
+    for(uint32_t i = 0; i < 1000; ++i) q.push_back(i);
+    for(uint32_t i = 0; i < 600; ++i) q.pop(), q.push_back(1000 + i); // Wrapped, so both segments are written.
+    std::stringstream ss;
+    circ::serialize(q, ss);
+    circ::deque<uint32_t> r;
+    circ::deserialize(r, ss);
+    CIRC_CHECK(r.size() == q.size());
+    for(uint32_t i = 0; i < q.size(); ++i) CIRC_CHECK(r[i] == q[i]);
+
+    circ::deque<std::string> s;
+    for(int i = 0; i < 100; ++i) s.push_back(std::string(size_t(i), 'z'));
+    std::stringstream ss2;
+    circ::serialize(s, ss2);
+    circ::deque<std::string> t;
+    circ::deserialize(t, ss2);
+    CIRC_CHECK(t.size() == 100 && t[57] == std::string(57, 'z'));
+}
+
+CIRC_TEST(serialize_empty) {
+    using stats_deque = circ::deque<uint64_t, uint32_t, circ::malloc_allocator, circ::op_stats>;
+    stats_deque q;
+    std::stringstream ss;
+    circ::serialize(q, ss);
+    stats_deque r;
+    r.push_back(7);
+    circ::deserialize(r, ss);
+    CIRC_CHECK(r.size() == 0 && r.stats().pushes == 1);
+
+    FILE *f = std::tmpfile();
+    CIRC_CHECK(f != nullptr);
+    circ::serialize(q, fileno(f));
+    std::rewind(f);
+    r.push_back(8);
+    circ::deserialize(r, fileno(f));
+    std::fclose(f);
+    CIRC_CHECK(r.size() == 0 && r.stats().pushes == 2);
+}
@@ -0,0 +1,140 @@
+// read_from_fd, write_to_fd and spill_deque against std::deque, and uring_reader over pipes in whichever mode the kernel allows.
+#include "test.h"
+#include "spill.h"
+#include "uring.h"
+#include <cerrno>
+#include <deque>
+#include <fcntl.h>
+#include <random>
+#include <string>
+#include <unistd.h>
+
+namespace {
+
+template<typename SizeType>
+void fuzz_fdio(unsigned seed) {
+    // Bytes go from src through a non-blocking pipe into dst, both deques wrapping and growing on the way.
+    // Each side is mirrored by a std::deque; a short or refused transfer must leave the deque consistent.
+    // src stays below 30000 bytes so that it fits a 16-bit ring while the pipe is full.
+    std::mt19937 rng(seed);
+    int fds[2];
+    CIRC_CHECK(::pipe(fds) == 0);
+    CIRC_CHECK(::fcntl(fds[0], F_SETFL, O_NONBLOCK) == 0 && ::fcntl(fds[1], F_SETFL, O_NONBLOCK) == 0);
+    circ::deque<char, SizeType> src, dst;
+    std::deque<char> src_ref, dst_ref, pipe_ref;
+    for(int it = 0; it < 20000; ++it) {
+        switch(rng() % 4) {
+            case 0: for(unsigned n = rng() % 3000; n && src_ref.size() < 30000; --n) {const char c = char(rng()); src.push_back(c); src_ref.push_back(c);} break;
+            case 1: {
+                const size_t max = rng() % 5000;
+                const ssize_t w = circ::write_to_fd(src, fds[1], max);
+                CIRC_CHECK(w >= 0 || errno == EAGAIN);
+                for(ssize_t k = 0; k < w; ++k) pipe_ref.push_back(src_ref.front()), src_ref.pop_front();
+                CIRC_CHECK(size_t(std::max<ssize_t>(w, 0)) <= max);
+            } break;
+            case 2: {
+                const size_t max = rng() % 5000;
+                const ssize_t r = circ::read_from_fd(dst, fds[0], max);
+                CIRC_CHECK(r >= 0 || errno == EAGAIN);
+                for(ssize_t k = 0; k < r; ++k) dst_ref.push_back(pipe_ref.front()), pipe_ref.pop_front();
+                CIRC_CHECK(size_t(std::max<ssize_t>(r, 0)) <= max);
+            } break;
+            case 3: for(unsigned n = rng() % 3000; n && dst_ref.size(); --n) {CIRC_CHECK(dst.pop() == dst_ref.front()); dst_ref.pop_front();} break;
+        }
+        if(it % 37 == 0) {
+            CIRC_CHECK(size_t(src.size()) == src_ref.size() && size_t(dst.size()) == dst_ref.size());
+            for(size_t k = 0; k < src_ref.size(); k += 61) CIRC_CHECK(src[k] == src_ref[k]);
+            for(size_t k = 0; k < dst_ref.size(); ++k) CIRC_CHECK(dst[k] == dst_ref[k]);
+        }
+    }
+    ::close(fds[1]);
+    ssize_t r;
+    for(; dst_ref.size(); dst_ref.pop_front()) CIRC_CHECK(dst.pop() == dst_ref.front());
+    while((r = circ::read_from_fd(dst, fds[0], 4096)) > 0)
+        for(ssize_t k = 0; k < r; ++k, pipe_ref.pop_front()) CIRC_CHECK(dst.pop() == pipe_ref.front());
+    CIRC_CHECK(r == 0 && pipe_ref.empty() && dst.size() == 0); // End of file leaves the deque as it was.
+    ::close(fds[0]);
+}
+
+template<typename T, size_t BlockSize>
+void fuzz_spill(unsigned seed, size_t max_in_memory) {
+    // Pushes outrun pops for long stretches, so blocks go to disk and come back from both ends.
+    std::mt19937 rng(seed);
+    circ::spill_deque<T, BlockSize> q(max_in_memory);
+    std::deque<T> ref;
+    size_t most_spilled = 0;
+    for(int it = 0; it < 20000; ++it) {
+        switch(rng() % 7) {
+            case 0: case 1: case 2:
+                for(unsigned n = rng() % (4 * BlockSize); n; --n) {
+                    const T x = T(rng());
+                    q.push_back(x);
+                    ref.push_back(x);
+                }
+                break;
+            case 3: case 4:
+                for(unsigned n = rng() % (3 * BlockSize); n && ref.size(); --n) {
+                    CIRC_CHECK(q.front() == ref.front());
+                    CIRC_CHECK(q.pop() == ref.front());
+                    ref.pop_front();
+                }
+                break;
+            case 5: case 6:
+                for(unsigned n = rng() % (3 * BlockSize); n && ref.size(); --n) {
+                    CIRC_CHECK(q.back() == ref.back());
+                    CIRC_CHECK(q.pop_back() == ref.back());
+                    ref.pop_back();
+                }
+                break;
+        }
+        CIRC_CHECK(q.size() == ref.size());
+        CIRC_CHECK(q.in_memory() <= std::max(max_in_memory, 2 * BlockSize) + 2 * BlockSize);
+        most_spilled = std::max(most_spilled, q.spilled());
+    }
+    CIRC_CHECK(most_spilled > 0);
+    for(; ref.size(); ref.pop_front()) CIRC_CHECK(q.pop() == ref.front());
+    CIRC_CHECK(q.empty() && q.file_size() == 0); // The file is truncated once every block has been read back.
+}
+
+} // namespace
+
+CIRC_TEST(spill_deque_fuzz) {
+    fuzz_spill<uint64_t, 16>(31, 40);
+    fuzz_spill<uint16_t, 64>(32, 0);
+    fuzz_spill<uint32_t, 8>(33, 1000);
+}
+
+CIRC_TEST(fdio_pipe_fuzz) {
+    fuzz_fdio<uint32_t>(17);
+    fuzz_fdio<uint16_t>(18); // Reads are clamped to what a 16-bit ring can index.
+}
+
+CIRC_TEST(uring_reader_pipe) {
+    int fds[2];
+    CIRC_CHECK(::pipe(fds) == 0);
+    const std::string msg = "abcdefghijklmnopqrstuvwxyz";
+    CIRC_CHECK(::write(fds[1], msg.data(), msg.size()) == ssize_t(msg.size()));
+    ::close(fds[1]);
+
+    circ::deque<char> q;
+    circ::uring_reader<circ::deque<char>> r(8);
+    CIRC_CHECK(r.prepare(q, fds[0], 10));
+    bool threw = false;
+    try {r.prepare(q, fds[0], 10);} catch(const std::runtime_error &) {threw = true;}
+    CIRC_CHECK(threw); // One pending read per deque.
+    // Chain reads from the completion callback until end of file.
+    bool eof = false;
+    const auto on_done = [&](circ::deque<char> &d, int fd, ssize_t res) {
+        CIRC_CHECK(res >= 0);
+        if(res == 0) eof = true;
+        else r.prepare(d, fd, 10), r.submit();
+    };
+    CIRC_CHECK(r.submit() == 1 && r.inflight() == 1);
+    for(int rounds = 0; !eof && rounds < 100; ++rounds) {
+        if(r.async()) r.submit(1);
+        r.complete(on_done);
+    }
+    ::close(fds[0]);
+    CIRC_CHECK(eof && r.inflight() == 0);
+    CIRC_CHECK(std::string(q.begin(), q.end()) == msg);
+}
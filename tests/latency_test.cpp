@@ -0,0 +1,92 @@
+// timed_deque against std::deque with a scripted clock, and log_linear_histogram against sorted samples.
+#include "test.h"
+#include "latency.h"
+#include <algorithm>
+#include <cmath>
+#include <deque>
+#include <random>
+#include <vector>
+
+namespace {
+
+struct fake_clock {
+    static uint64_t ticks;
+    static uint64_t now() {return ticks;}
+};
+uint64_t fake_clock::ticks = 0;
+
+template<unsigned SubBits>
+void check_percentiles(const circ::log_linear_histogram<SubBits> &h, std::vector<uint64_t> samples) {
+    // Each answer is the exact order statistic rounded up to the top of its bucket, at most 2^-SubBits above it.
+    std::sort(samples.begin(), samples.end());
+    CIRC_CHECK(h.count() == samples.size());
+    if(samples.empty()) return;
+    CIRC_CHECK(h.min() == samples.front() && h.max() == samples.back());
+    for(const double q: {0.0, 0.1, 0.5, 0.9, 0.99, 0.999, 1.0}) {
+        const size_t rank = std::max<size_t>(1, size_t(std::ceil(q * samples.size())));
+        const uint64_t exact = samples[rank - 1], got = h.percentile(q);
+        CIRC_CHECK(got >= exact && got - exact <= (exact >> SubBits));
+    }
+}
+
+} // namespace
+
+CIRC_TEST(log_linear_histogram_percentiles) {
+    std::mt19937_64 rng(15);
+    circ::log_linear_histogram<5> a, b;
+    std::vector<uint64_t> all;
+    for(int i = 0; i < 20000; ++i) {
+        const uint64_t v = rng() >> (rng() % 64); // Spread over every magnitude.
+        (i % 2 ? a: b).record(v);
+        all.push_back(v);
+    }
+    a.merge(b);
+    check_percentiles(a, all);
+    circ::log_linear_histogram<2> coarse;
+    std::vector<uint64_t> small;
+    for(uint64_t v = 0; v < 1000; ++v) coarse.record(v * v), small.push_back(v * v);
+    check_percentiles(coarse, small);
+    uint64_t buckets = 0, prev_high = 0;
+    bool ordered = true;
+    coarse.for_each_bucket([&](uint64_t lo, uint64_t hi, uint64_t n) {
+        ordered &= lo <= hi && (buckets == 0 || lo > prev_high);
+        prev_high = hi;
+        buckets += n;
+    });
+    CIRC_CHECK(ordered && buckets == 1000);
+}
+
+CIRC_TEST(timed_deque_fuzz) {
+    // Every pop records exactly the time its element spent queued.
+    std::mt19937 rng(16);
+    circ::timed_deque<int, uint32_t, fake_clock, 6> q;
+    std::deque<std::pair<int, uint64_t>> ref; // (value, push time)
+    std::vector<uint64_t> sojourns;
+    fake_clock::ticks = 1000;
+    for(int it = 0; it < 30000; ++it) {
+        fake_clock::ticks += rng() % 50;
+        switch(rng() % 6) {
+            case 0: case 1: q.push_back(it); ref.emplace_back(it, fake_clock::ticks); break;
+            case 2: q.push_front(it); ref.emplace_front(it, fake_clock::ticks); break;
+            case 3: case 4: if(ref.size()) {
+                CIRC_CHECK(q.front() == ref.front().first && q.front_age() == fake_clock::ticks - ref.front().second);
+                CIRC_CHECK(q.pop() == ref.front().first);
+                sojourns.push_back(fake_clock::ticks - ref.front().second);
+                ref.pop_front();
+            } break;
+            case 5: if(ref.size()) {
+                CIRC_CHECK(q.back() == ref.back().first && q.pop_back() == ref.back().first);
+                sojourns.push_back(fake_clock::ticks - ref.back().second);
+                ref.pop_back();
+            } break;
+        }
+        CIRC_CHECK(size_t(q.size()) == ref.size());
+    }
+    size_t i = 0;
+    bool same = true;
+    q.for_each([&](int x) {same &= x == ref[i++].first;});
+    CIRC_CHECK(same && i == ref.size());
+    check_percentiles(q.histogram(), sojourns);
+    q.reset_histogram();
+    CIRC_CHECK(q.histogram().count() == 0);
+}
@@ -0,0 +1,22 @@
+// Runs every test whose name contains argv[1] (all of them without an argument).
+#include "test.h"
+#include <cstring>
+#include <exception>
+
+int main(int argc, char **argv) {
+    const char *filter = argc > 1 ? argv[1]: "";
+    unsigned run = 0, failed = 0;
+    for(const auto &t: circ::test::registry()) {
+        if(!std::strstr(t.name, filter)) continue;
+        ++run;
+        try {
+            t.func();
+            std::printf("ok    %s\n", t.name);
+        } catch(const std::exception &e) {
+            ++failed;
+            std::printf("FAIL  %s: %s\n", t.name, e.what());
+        }
+    }
+    std::printf("%u/%u tests passed\n", run - failed, run);
+    return failed || !run;
+}
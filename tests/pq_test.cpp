@@ -0,0 +1,133 @@
+// Differential tests of the monotone priority queues and the timing wheel against std containers.
+#include "test.h"
+#include "bucket.h"
+#include "calendar.h"
+#include "radix.h"
+#include "wheel.h"
+#include <map>
+#include <queue>
+#include <random>
+
+namespace {
+
+using entry = std::pair<uint64_t, uint64_t>; // (priority, insertion order)
+using min_heap = std::priority_queue<entry, std::vector<entry>, std::greater<entry>>;
+
+// Hold model with bursts: pops never see a priority below the last one popped.
+template<typename Push, typename Pop>
+void hold_model(unsigned seed, uint64_t max_step, const Push &push, const Pop &pop, bool fifo_ties) {
+    std::mt19937_64 rng(seed);
+    min_heap ref;
+    uint64_t now = 0, id = 0;
+    for(int it = 0; it < 100000; ++it) {
+        const bool grow = (it / 5000) % 2 == 0;
+        if(ref.empty() || rng() % 100 < (grow ? 65u: 35u)) {
+            const uint64_t prio = now + rng() % max_step;
+            push(prio, id);
+            ref.emplace(prio, id++);
+        } else {
+            uint64_t prio;
+            const uint64_t got = pop(prio);
+            CIRC_CHECK(prio == ref.top().first);
+            if(fifo_ties) CIRC_CHECK(got == ref.top().second);
+            now = prio;
+            ref.pop();
+        }
+    }
+}
+
+} // namespace
+
+CIRC_TEST(bucket_queue_fuzz) {
+    circ::bucket_queue<uint64_t> q(1000);
+    hold_model(1, 1000, [&](uint64_t p, uint64_t v) {q.push(p, v);},
+                        [&](uint64_t &p) {return q.pop(p);}, true);
+}
+
+CIRC_TEST(bucket_queue_empty) {
+    circ::bucket_queue<int> q(100);
+    bool threw = false;
+    try {q.top_priority();} catch(const std::runtime_error &) {threw = true;}
+    CIRC_CHECK(threw);
+    threw = false;
+    try {q.top();} catch(const std::runtime_error &) {threw = true;}
+    CIRC_CHECK(threw);
+    q.push(5, 1);
+    CIRC_CHECK(q.top_priority() == 5 && q.pop() == 1);
+    threw = false;
+    try {q.pop();} catch(const std::runtime_error &) {threw = true;}
+    CIRC_CHECK(threw);
+}
+
+CIRC_TEST(radix_heap_fuzz) {
+    circ::radix_heap<uint64_t, uint64_t> q;
+    hold_model(2, 1 << 20, [&](uint64_t p, uint64_t v) {q.push(p, v);},
+                           [&](uint64_t &p) {return q.pop(p);}, false);
+    circ::radix_heap<uint32_t, uint64_t> q32;
+    hold_model(3, 1 << 12, [&](uint64_t p, uint64_t v) {q32.push(uint32_t(p), v);},
+                           [&](uint64_t &p) {uint32_t k; const uint64_t v = q32.pop(k); p = k; return v;}, false);
+}
+
+CIRC_TEST(calendar_queue_fuzz) {
+    circ::calendar_queue<uint64_t, uint64_t> q;
+    hold_model(4, 5000, [&](uint64_t p, uint64_t v) {q.push(p, v);},
+                        [&](uint64_t &p) {return q.pop(p);}, true);
+    circ::calendar_queue<uint64_t> qd;
+    hold_model(5, 1 << 16, [&](uint64_t p, uint64_t v) {qd.push(double(p) / 7, v);},
+                           [&](uint64_t &p) {double t; const uint64_t v = qd.pop(t); p = uint64_t(t * 7 + 0.5); return v;}, true);
+    try {
+        qd.push(-1.0, 0);
+        CIRC_CHECK(false);
+    } catch(const std::runtime_error &) {}
+}
+
+CIRC_TEST(timer_wheel_fuzz) {
+    // Timers fire exactly at their expiry tick, cancelled ones never do.
+    std::mt19937_64 rng(6);
+    circ::timer_wheel<uint64_t, 3, 4> w;
+    std::map<uint64_t, std::pair<uint64_t, circ::timer_id>> live; // id -> (expiry, handle)
+    uint64_t id = 0;
+    for(int it = 0; it < 20000; ++it) {
+        const unsigned op = rng() % 10;
+        if(op < 5) {
+            const uint64_t delay = rng() % 4 == 0 ? rng() % 20000: rng() % 300;
+            live[id] = {w.now() + delay, w.schedule_after(delay, id)};
+            ++id;
+        } else if(op < 7 && !live.empty()) {
+            auto victim = live.lower_bound(rng() % id);
+            if(victim == live.end()) victim = live.begin();
+            CIRC_CHECK(w.cancel(victim->second.second));
+            CIRC_CHECK(!w.cancel(victim->second.second));
+            live.erase(victim);
+        } else {
+            const uint64_t to = w.now() + rng() % 50;
+            uint64_t last = 0;
+            w.advance(to, [&](uint64_t fired) {
+                auto found = live.find(fired);
+                CIRC_CHECK(found != live.end());
+                CIRC_CHECK(found->second.first <= to && found->second.first >= last);
+                last = found->second.first;
+                live.erase(found);
+            });
+            for(const auto &kv: live) CIRC_CHECK(kv.second.first > to);
+        }
+        CIRC_CHECK(w.size() == live.size());
+    }
+}
+
+CIRC_TEST(timer_wheel_past_due) {
+    // A timer scheduled at or before now() fires on the next advance, whatever slot its expiry maps to.
+    for(const uint64_t start: {uint64_t(0), uint64_t(1000)}) {
+        circ::timer_wheel<int, 3, 4> w(start);
+        if(start == 0) w.advance(1000, [](int) {});
+        w.schedule(500, 1);
+        w.schedule(1000, 2);
+        w.schedule(1, 3);
+        w.schedule(1001, 4);
+        int seen = 0;
+        CIRC_CHECK(w.advance(1000, [&](int x) {seen |= 1 << x;}) == 3);
+        CIRC_CHECK(seen == 0xe);
+        CIRC_CHECK(w.advance(1001, [&](int x) {seen |= 1 << x;}) == 1);
+        CIRC_CHECK(seen == 0x1e && w.empty());
+    }
+}
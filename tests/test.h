@@ -0,0 +1,42 @@
+#pragma once
+#ifndef CIRCULAR_QUEUE_TEST_H__
+#define CIRCULAR_QUEUE_TEST_H__
+// A minimal test harness: CIRC_TEST(name) registers a test, CIRC_CHECK records a failure and
+// stops the test. tests/main.cpp runs every registered test whose name contains argv[1].
+#include <cstdio>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace circ { namespace test {
+
+struct failure: std::runtime_error {
+    using std::runtime_error::runtime_error;
+};
+struct entry {
+    const char           *name;
+    std::function<void()> func;
+};
+inline std::vector<entry> &registry() {
+    static std::vector<entry> ret;
+    return ret;
+}
+struct registrar {
+    registrar(const char *name, std::function<void()> func) {registry().push_back(entry{name, std::move(func)});}
+};
+
+}} // namespace circ::test
+
+#define CIRC_TEST_CAT2(a, b) a##b
+#define CIRC_TEST_CAT(a, b) CIRC_TEST_CAT2(a, b)
+#define CIRC_TEST(name) \
+    static void name(); \
+    static const circ::test::registrar CIRC_TEST_CAT(name, _registrar)(#name, name); \
+    static void name()
+#define CIRC_CHECK(cond) \
+    do { \
+        if(!(cond)) throw circ::test::failure(std::string(__FILE__) + ":" + std::to_string(__LINE__) + ": " #cond); \
+    } while(0)
+
+#endif /* #ifndef CIRCULAR_QUEUE_TEST_H__ */
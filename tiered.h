@@ -0,0 +1,161 @@
+#pragma once
+#ifndef CIRCULAR_QUEUE_TIERED_H__
+#define CIRCULAR_QUEUE_TIERED_H__
+#include "codec.h"
+
+namespace circ {
+
+template<typename T, typename Codec=delta_varint_codec<T>, unsigned BlockSize=1024, typename SizeType=uint32_t, typename Allocator=malloc_allocator>
+class tiered_deque: private Allocator {
+    // A FIFO for long histories which keeps only its ends uncompressed.
+    // Elements live in three tiers, front to back:
+    //   head_: the block at the front, decompressed once pop reaches it;
+    //   cold_: full blocks of BlockSize elements, each compressed with Codec into its own allocation;
+    //   hot_:  the newest elements, a plain deque.
+    // push_back appends to hot_; once hot_ holds 2 * BlockSize - 1 elements, its oldest BlockSize are
+    // encoded into a new cold block, so hot_ never reallocates and each push pays O(1) amortized encoding.
+    // Only head_ and hot_ are kept uncompressed, so memory is about 3 * BlockSize elements plus the
+    // compressed blocks, whatever the length of the queue.
+    static_assert(std::is_trivially_copyable<T>::value, "Compressed tiers store elements as bytes");
+    static_assert(BlockSize >= 2, "Blocks must hold at least two elements");
+    struct cold_block {
+        uint8_t *bytes;
+        size_t   nbytes;
+    };
+    deque<T, SizeType, Allocator>          head_;
+    deque<cold_block, SizeType, Allocator> cold_;
+    deque<T, SizeType, Allocator>          hot_;
+    T                                     *stage_;   // BlockSize elements, contiguous, for encoding.
+    uint8_t                               *scratch_; // Codec::bound(BlockSize) bytes.
+    size_t                                 cold_bytes_;
+
+    void spill() {
+        // Encode the oldest BlockSize elements of hot_ into a cold block.
+        T *ptrs[2];
+        SizeType lens[2];
+        const unsigned n = hot_.used_segments(ptrs, lens);
+        size_t copied = 0;
+        for(unsigned i = 0; i < n && copied < BlockSize; ++i) {
+            const size_t take = std::min(size_t(lens[i]), size_t(BlockSize) - copied);
+            std::memcpy(static_cast<void *>(stage_ + copied), ptrs[i], take * sizeof(T));
+            copied += take;
+        }
+        assert(copied == BlockSize);
+        const size_t nbytes = Codec::encode(stage_, BlockSize, scratch_);
+        uint8_t *bytes = static_cast<uint8_t *>(this->allocate(nbytes));
+        if(__builtin_expect(bytes == nullptr, 0)) throw std::bad_alloc();
+        std::memcpy(bytes, scratch_, nbytes);
+        cold_.push_back(cold_block{bytes, nbytes});
+        cold_bytes_ += nbytes;
+        hot_.discard_front(BlockSize);
+    }
+    // Decode a cold block into q, which must be empty, and free it.
+    void thaw(const cold_block &b, deque<T, SizeType, Allocator> &q) {
+        assert(q.size() == 0);
+        q.clear(); // Resets start_ to 0, so the free space is one contiguous run.
+        T *ptrs[2] = {}; // free_segments always fills ptrs[0] here; this quiets -Wmaybe-uninitialized.
+        SizeType lens[2];
+        q.free_segments(ptrs, lens);
+        assert(lens[0] >= BlockSize);
+        Codec::decode(b.bytes, b.nbytes, ptrs[0], BlockSize);
+        q.commit_back(BlockSize);
+        cold_bytes_ -= b.nbytes;
+        this->deallocate(b.bytes, b.nbytes);
+    }
+    void load_front() {
+        if(head_.size() == 0 && cold_.size()) thaw(cold_.pop(), head_);
+    }
+    void load_back() {
+        if(hot_.size() == 0 && cold_.size()) thaw(cold_.pop_back(), hot_);
+    }
+
+public:
+    using size_type = SizeType;
+    using codec_type = Codec;
+    tiered_deque(const Allocator &alloc=Allocator()):
+        Allocator(alloc), head_(BlockSize, alloc), cold_(3, alloc), hot_(2 * BlockSize - 1, alloc),
+        stage_(static_cast<T *>(this->allocate(sizeof(T) * BlockSize))),
+        scratch_(static_cast<uint8_t *>(this->allocate(Codec::bound(BlockSize)))),
+        cold_bytes_(0)
+    {
+        if(stage_ == nullptr || scratch_ == nullptr) throw std::bad_alloc();
+    }
+    tiered_deque(const tiered_deque &) = delete;
+    tiered_deque &operator=(const tiered_deque &) = delete;
+    ~tiered_deque() {
+        clear();
+        this->deallocate(stage_, sizeof(T) * BlockSize);
+        this->deallocate(scratch_, Codec::bound(BlockSize));
+    }
+    template<typename... Args>
+    T &push_back(Args &&... args) {
+        if(__builtin_expect(hot_.size() == 2 * BlockSize - 1, 0)) spill();
+        return hot_.push_back(std::forward<Args>(args)...);
+    }
+    template<typename... Args>
+    T &emplace_back(Args &&... args) {
+        return push_back(std::forward<Args>(args)...); // Interface compatibility.
+    }
+    template<typename... Args>
+    T &push(Args &&... args) {
+        return push_back(std::forward<Args>(args)...); // Interface compatibility
+    }
+    T pop() {
+        load_front();
+        return head_.size() ? head_.pop(): hot_.pop();
+    }
+    T pop_front() {
+        return pop(); // Interface compatibility with std::list.
+    }
+    T pop_back() {
+        load_back();
+        return hot_.size() ? hot_.pop_back(): head_.pop_back();
+    }
+    // May decompress a block, hence not const.
+    T &front() {
+        load_front();
+        return head_.size() ? head_.front(): hot_.front();
+    }
+    T &back() {
+        load_back();
+        return hot_.size() ? hot_.back(): head_.back();
+    }
+    // Visits every element in order, decoding cold blocks into a temporary buffer as it goes.
+    template<typename Functor>
+    void for_each(const Functor &func) const {
+        head_.for_each(func);
+        std::vector<T> tmp(BlockSize);
+        cold_.for_each([&](const cold_block &b) {
+            Codec::decode(b.bytes, b.nbytes, tmp.data(), BlockSize);
+            for(const T &x: tmp) func(x);
+        });
+        hot_.for_each(func);
+    }
+    std::vector<T> to_vector() const {
+        std::vector<T> ret;
+        ret.reserve(size());
+        for_each([&ret](const T &x) {ret.push_back(x);});
+        return ret;
+    }
+    void clear() {
+        head_.clear();
+        while(cold_.size()) {
+            const cold_block b = cold_.pop();
+            this->deallocate(b.bytes, b.nbytes);
+        }
+        hot_.clear();
+        cold_bytes_ = 0;
+    }
+    size_t size() const noexcept {return size_t(head_.size()) + size_t(cold_.size()) * BlockSize + hot_.size();}
+    bool empty()  const noexcept {return size() == 0;}
+    size_type cold_blocks() const noexcept {return cold_.size();}
+    // Heap bytes held: buffers for the uncompressed tiers, the block index and the compressed blocks.
+    size_t memory_usage() const noexcept {
+        return (size_t(head_.capacity() + 1) + hot_.capacity() + 1 + BlockSize) * sizeof(T) + Codec::bound(BlockSize)
+             + (size_t(cold_.capacity()) + 1) * sizeof(cold_block) + cold_bytes_;
+    }
+}; // tiered_deque
+
+} // namespace circ
+
+#endif /* #ifndef CIRCULAR_QUEUE_TIERED_H__ */
@@ -0,0 +1,235 @@
+#pragma once
+#ifndef CIRCULAR_QUEUE_URING_H__
+#define CIRCULAR_QUEUE_URING_H__
+#include "fdio.h"
+#include <cerrno>
+#include <unordered_set>
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#define CIRC_HAVE_IO_URING 1
+#endif
+
+namespace circ {
+
+template<typename Deque>
+class uring_reader {
+    // Batched asynchronous reads from many descriptors, each into the free segments of its own byte deque.
+    // prepare() queues a readv per (deque, fd) pair; submit() hands the whole batch to the kernel
+    // with one io_uring_enter, and complete() advances each deque's stop_ by what its read returned.
+    // Uses the io_uring syscalls directly, so liburing is not required. Where io_uring is unavailable
+    // (old kernels or headers, seccomp, non-Linux), submit() performs the reads synchronously with readv,
+    // so callers see the same interface either way.
+    // While a read into a deque is in flight, pop from it freely but do not push or resize it.
+    // Each deque may have one read staged or in flight at a time: the next one's free segments
+    // are only known once the previous read completes.
+    // Not threadsafe: use one per thread.
+    using size_type = typename Deque::size_type;
+    using value_type = typename Deque::value_type;
+    struct op {
+        Deque       *q;
+        int          fd;
+        size_t       max;
+        struct iovec iov[2];
+        int          niov;
+        ssize_t      res;
+    };
+    std::vector<op>       ops_;
+    std::vector<unsigned> free_ops_;
+    std::vector<unsigned> staged_; // Prepared but not yet submitted.
+    std::vector<unsigned> done_;   // Completed synchronously, in fallback mode.
+    std::unordered_set<const Deque *> pending_; // Deques with a read staged or in flight.
+    unsigned              inflight_;
+    unsigned              unsubmitted_; // In the submission ring, not yet consumed by the kernel.
+    int                   ring_fd_;
+#ifdef CIRC_HAVE_IO_URING
+    // Submission and completion rings, mapped from the kernel.
+    void          *sq_ptr_;
+    void          *cq_ptr_;
+    size_t         sq_bytes_;
+    size_t         cq_bytes_;
+    io_uring_sqe  *sqes_;
+    size_t         sqes_bytes_;
+    unsigned      *sq_tail_;
+    unsigned      *sq_mask_;
+    unsigned      *sq_array_;
+    unsigned      *cq_head_;
+    unsigned      *cq_tail_;
+    unsigned      *cq_mask_;
+    io_uring_cqe  *cqes_;
+
+    bool setup(unsigned entries) {
+        io_uring_params p;
+        std::memset(&p, 0, sizeof(p));
+        ring_fd_ = int(::syscall(__NR_io_uring_setup, entries, &p));
+        if(ring_fd_ < 0) return false;
+        sq_bytes_ = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+        cq_bytes_ = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+        const bool single = p.features & IORING_FEAT_SINGLE_MMAP;
+        if(single) sq_bytes_ = cq_bytes_ = std::max(sq_bytes_, cq_bytes_);
+        sq_ptr_ = ::mmap(nullptr, sq_bytes_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQ_RING);
+        if(sq_ptr_ == MAP_FAILED) return teardown();
+        cq_ptr_ = single ? sq_ptr_: ::mmap(nullptr, cq_bytes_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_CQ_RING);
+        if(cq_ptr_ == MAP_FAILED) return teardown();
+        sqes_bytes_ = p.sq_entries * sizeof(io_uring_sqe);
+        sqes_ = static_cast<io_uring_sqe *>(::mmap(nullptr, sqes_bytes_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQES));
+        if(sqes_ == MAP_FAILED) return teardown();
+        char *const sq = static_cast<char *>(sq_ptr_), *const cq = static_cast<char *>(cq_ptr_);
+        sq_tail_  = reinterpret_cast<unsigned *>(sq + p.sq_off.tail);
+        sq_mask_  = reinterpret_cast<unsigned *>(sq + p.sq_off.ring_mask);
+        sq_array_ = reinterpret_cast<unsigned *>(sq + p.sq_off.array);
+        cq_head_  = reinterpret_cast<unsigned *>(cq + p.cq_off.head);
+        cq_tail_  = reinterpret_cast<unsigned *>(cq + p.cq_off.tail);
+        cq_mask_  = reinterpret_cast<unsigned *>(cq + p.cq_off.ring_mask);
+        cqes_     = reinterpret_cast<io_uring_cqe *>(cq + p.cq_off.cqes);
+        return true;
+    }
+    bool teardown() {
+        if(ring_fd_ < 0) return false;
+        if(sqes_ && sqes_ != MAP_FAILED) ::munmap(sqes_, sqes_bytes_);
+        if(cq_ptr_ && cq_ptr_ != MAP_FAILED && cq_ptr_ != sq_ptr_) ::munmap(cq_ptr_, cq_bytes_);
+        if(sq_ptr_ && sq_ptr_ != MAP_FAILED) ::munmap(sq_ptr_, sq_bytes_);
+        ::close(ring_fd_);
+        ring_fd_ = -1;
+        return false;
+    }
+#endif
+
+    // Fill in the iovecs for a staged op from its deque's current free segments.
+    void describe(op &o) {
+        if(o.q->capacity() - o.q->size() < o.max) o.q->reserve(size_type(o.q->size() + o.max));
+        value_type *ptrs[2];
+        size_type lens[2];
+        const unsigned n = o.q->free_segments(ptrs, lens);
+        o.niov = segments_to_iovec(o.iov, ptrs, lens, n, o.max);
+    }
+
+public:
+    uring_reader(unsigned entries=256): ops_(entries), inflight_(0), unsubmitted_(0), ring_fd_(-1) {
+        static_assert(sizeof(value_type) == 1, "uring_reader requires a deque of bytes");
+        if(__builtin_expect(entries == 0 || (entries & (entries - 1)), 0)) throw std::runtime_error("io_uring needs a power of two number of entries. Abort!");
+        free_ops_.reserve(entries);
+        for(unsigned i = entries; i--; free_ops_.push_back(i));
+#ifdef CIRC_HAVE_IO_URING
+        sq_ptr_ = cq_ptr_ = nullptr;
+        sqes_ = nullptr;
+        setup(entries);
+#endif
+    }
+    uring_reader(const uring_reader &) = delete;
+    uring_reader &operator=(const uring_reader &) = delete;
+    ~uring_reader() {
+#ifdef CIRC_HAVE_IO_URING
+        teardown();
+#endif
+    }
+    // Whether reads really are asynchronous, rather than emulated.
+    bool async() const {return ring_fd_ >= 0;}
+    // Queue a read of up to max bytes from fd onto q. False if entries reads are already outstanding.
+    // Throws if q already has a read staged or in flight.
+    bool prepare(Deque &q, int fd, size_t max) {
+        if(free_ops_.empty()) return false;
+        if(__builtin_expect(!pending_.insert(&q).second, 0)) throw std::runtime_error("uring_reader already has a read pending on this deque. Abort!");
+        const unsigned i = free_ops_.back();
+        free_ops_.pop_back();
+        op &o = ops_[i];
+        o.q = &q, o.fd = fd, o.max = std::min(max, std::min(size_t(SSIZE_MAX), size_t(size_type(-1) >> 1) - q.size()));
+        o.res = 0;
+        staged_.push_back(i);
+        return true;
+    }
+    // Submit everything prepared since the last call, waiting until at least wait_for reads have completed.
+    // Returns the number of reads the kernel accepted. Any it did not take, including all of them
+    // if io_uring_enter throws, stay in the submission ring and go with the next call.
+    unsigned submit(unsigned wait_for=0) {
+        const unsigned n = staged_.size();
+        if(!async()) {
+            for(const unsigned i: staged_) {
+                op &o = ops_[i];
+                describe(o);
+                o.res = o.niov ? ::readv(o.fd, o.iov, o.niov): 0;
+                if(o.res < 0) o.res = -errno;
+                done_.push_back(i);
+            }
+            staged_.clear();
+            inflight_ += n;
+            return n;
+        }
+#ifdef CIRC_HAVE_IO_URING
+        unsigned tail = *sq_tail_;
+        for(const unsigned i: staged_) {
+            op &o = ops_[i];
+            describe(o);
+            const unsigned idx = tail++ & *sq_mask_;
+            io_uring_sqe &sqe = sqes_[idx];
+            std::memset(&sqe, 0, sizeof(sqe));
+            sqe.opcode = IORING_OP_READV;
+            sqe.fd = o.fd;
+            sqe.addr = reinterpret_cast<uint64_t>(o.iov);
+            sqe.len = o.niov;
+            sqe.off = uint64_t(-1); // Read at the current file position, as for pipes and sockets.
+            sqe.user_data = i;
+            sq_array_[idx] = idx;
+        }
+        __atomic_store_n(sq_tail_, tail, __ATOMIC_RELEASE);
+        staged_.clear();
+        unsubmitted_ += n;
+        const unsigned flags = wait_for ? IORING_ENTER_GETEVENTS: 0;
+        long accepted = 0;
+        if(unsubmitted_ || wait_for) {
+            // The kernel does not wait when it takes fewer entries than offered, so min_complete may count them.
+            while((accepted = ::syscall(__NR_io_uring_enter, ring_fd_, unsubmitted_, std::min(wait_for, inflight_ + unsubmitted_), flags, nullptr, 0)) < 0) {
+                if(errno != EINTR) throw std::runtime_error(std::string("io_uring_enter failed: ") + std::strerror(errno) + ". Abort!");
+            }
+            unsubmitted_ -= unsigned(accepted);
+            inflight_ += unsigned(accepted);
+        }
+        return unsigned(accepted);
+#else
+        (void)wait_for;
+        return n;
+#endif
+    }
+    // Apply finished reads, calling func(deque, fd, result) for each. result is the byte count,
+    // 0 at end of file, or a negated errno, as io_uring reports it. Returns the number completed.
+    template<typename Functor>
+    unsigned complete(const Functor &func) {
+        unsigned ret = 0;
+        const auto finish = [&](unsigned i, ssize_t res) {
+            op &o = ops_[i];
+            Deque &q = *o.q;
+            if(res > 0) q.commit_back(size_type(res));
+            pending_.erase(&q);
+            o.q = nullptr;
+            free_ops_.push_back(i);
+            --inflight_;
+            ++ret;
+            func(q, o.fd, res);
+        };
+        if(!async()) {
+            std::vector<unsigned> done;
+            done.swap(done_); // func may prepare and submit again, which appends to done_.
+            for(const unsigned i: done) finish(i, ops_[i].res);
+            return ret;
+        }
+#ifdef CIRC_HAVE_IO_URING
+        unsigned head = *cq_head_;
+        const unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+        while(head != tail) {
+            const io_uring_cqe &cqe = cqes_[head & *cq_mask_];
+            const unsigned i = unsigned(cqe.user_data);
+            const ssize_t res = cqe.res;
+            __atomic_store_n(cq_head_, ++head, __ATOMIC_RELEASE); // Release the slot before func can submit more.
+            finish(i, res);
+        }
+#endif
+        return ret;
+    }
+    unsigned inflight() const noexcept {return inflight_;}
+}; // uring_reader
+
+} // namespace circ
+
+#endif /* #ifndef CIRCULAR_QUEUE_URING_H__ */
@@ -0,0 +1,168 @@
+#pragma once
+#ifndef CIRCULAR_QUEUE_WHEEL_H__
+#define CIRCULAR_QUEUE_WHEEL_H__
+#include "segmented.h"
+
+namespace circ {
+
+struct timer_id {
+    uint32_t index;
+    uint32_t generation;
+};
+
+template<typename T, unsigned Levels=4, unsigned SlotBits=8>
+class timer_wheel {
+    // A hierarchical timing wheel (Varghese & Lauck) for timeouts: schedule and cancel are O(1),
+    // and advance() costs O(1) per tick plus O(1) per timer fired or cascaded.
+    // Each level is a power-of-two ring of 2^SlotBits slots indexed with a mask, as in deque; level L
+    // has a resolution of 2^(SlotBits * L) ticks. A timer due in d ticks lives at the lowest level
+    // whose span exceeds d, in the slot given by its expiry's bits at that level. Whenever the ticks
+    // of level L wrap, the slot of level L + 1 whose time has come is cascaded: its timers are
+    // re-inserted, landing at lower levels, until they reach level 0 and fire.
+    // Timers further out than the top level's span are parked in its farthest slot and re-examined.
+    // Slots are intrusive doubly-linked lists threaded through one node pool, so cancellation unlinks
+    // in place. Handles carry a generation, so cancelling a fired or cancelled timer is a harmless no-op.
+    static_assert(Levels >= 1 && SlotBits >= 1 && Levels * SlotBits < 64, "Unsupported wheel geometry");
+    static constexpr uint32_t nil = UINT32_MAX;
+    static constexpr uint64_t nslots = uint64_t(1) << SlotBits;
+    static constexpr uint64_t slot_mask = nslots - 1;
+    static constexpr uint64_t span = uint64_t(1) << (Levels * SlotBits); // Ticks covered by the whole wheel.
+    struct node {
+        uint64_t expiry;
+        uint32_t prev, next;
+        uint32_t slot; // level * nslots + index, or nil while free.
+        uint32_t generation;
+        alignas(T) unsigned char storage[sizeof(T)];
+        T &value() {return *reinterpret_cast<T *>(storage);}
+    };
+    segmented_deque<node> nodes_; // Stable addresses, so values are never relocated as the pool grows.
+    uint32_t          free_;    // Head of the free list, through next.
+    uint32_t          heads_[Levels * nslots];
+    uint64_t          now_;
+    size_t            size_;
+
+    void link(uint32_t i) {
+        node &n = nodes_[i];
+        uint64_t delta = n.expiry > now_ ? n.expiry - now_: 0;
+        unsigned level = 0;
+        while(level + 1 < Levels && delta >= (uint64_t(1) << ((level + 1) * SlotBits))) ++level;
+        const uint64_t when = delta < span ? std::max(n.expiry, now_): now_ + span - 1; // Past-due timers go in the current slot.
+        const uint32_t slot = uint32_t(level * nslots + ((when >> (level * SlotBits)) & slot_mask));
+        n.slot = slot;
+        n.prev = nil;
+        n.next = heads_[slot];
+        if(n.next != nil) nodes_[n.next].prev = i;
+        heads_[slot] = i;
+    }
+    void unlink(uint32_t i) {
+        node &n = nodes_[i];
+        if(n.prev != nil) nodes_[n.prev].next = n.next;
+        else heads_[n.slot] = n.next;
+        if(n.next != nil) nodes_[n.next].prev = n.prev;
+    }
+    void release(uint32_t i) {
+        node &n = nodes_[i];
+        n.slot = nil;
+        ++n.generation;
+        n.next = free_;
+        free_ = i;
+        --size_;
+    }
+    void cascade(unsigned level) {
+        // Detach the slot first: timers parked beyond the wheel's span are relinked into it.
+        uint32_t &head = heads_[level * nslots + ((now_ >> (level * SlotBits)) & slot_mask)];
+        uint32_t i = head;
+        head = nil;
+        for(uint32_t next; i != nil; i = next) {
+            next = nodes_[i].next;
+            link(i);
+        }
+    }
+
+public:
+    using value_type = T;
+    timer_wheel(uint64_t now=0): free_(nil), now_(now), size_(0) {
+        std::fill(std::begin(heads_), std::end(heads_), nil);
+    }
+    timer_wheel(const timer_wheel &) = delete;
+    timer_wheel &operator=(const timer_wheel &) = delete;
+    ~timer_wheel() {
+        nodes_.for_each([](node &n) {if(n.slot != nil) n.value().~T();});
+    }
+    // Fire at tick when (immediately on the next advance if when <= now()).
+    template<typename... Args>
+    timer_id schedule(uint64_t when, Args &&... args) {
+        uint32_t i = free_;
+        if(i == nil) {
+            if(__builtin_expect(nodes_.size() >= nil, 0)) throw std::runtime_error("Too many timers. Abort!");
+            i = uint32_t(nodes_.size());
+            nodes_.push_back().generation = 0;
+        } else free_ = nodes_[i].next;
+        node &n = nodes_[i];
+        new(n.storage) T(std::forward<Args>(args)...);
+        n.expiry = when;
+        link(i);
+        ++size_;
+        return timer_id{i, n.generation};
+    }
+    template<typename... Args>
+    timer_id schedule_after(uint64_t delay, Args &&... args) {
+        return schedule(now_ + delay, std::forward<Args>(args)...);
+    }
+    // False if the timer already fired or was cancelled.
+    bool cancel(timer_id id) {
+        if(id.index >= nodes_.size()) return false;
+        node &n = nodes_[id.index];
+        if(n.generation != id.generation || n.slot == nil) return false;
+        unlink(id.index);
+        n.value().~T();
+        release(id.index);
+        return true;
+    }
+    // Move time forward to now, calling func(T &) for every timer due by then, in order of expiry
+    // tick (in no particular order within a tick). func may schedule and cancel timers.
+    // Returns the number fired.
+    template<typename Functor>
+    size_t advance(uint64_t now, const Functor &func) {
+        size_t fired = 0;
+        for(;;) {
+            uint32_t &head = heads_[now_ & slot_mask];
+            while(head != nil) {
+                const uint32_t i = head;
+                unlink(i);
+                if(__builtin_expect(nodes_[i].expiry > now_, 0)) {
+                    link(i); // Parked beyond the span of a one-level wheel.
+                    continue;
+                }
+                T value(std::move(nodes_[i].value()));
+                nodes_[i].value().~T();
+                release(i);
+                ++fired;
+                func(value);
+            }
+            if(now_ >= now) break;
+            if(size_ == 0) {
+                now_ = now; // Nothing to fire or cascade on the way.
+                continue;
+            }
+            ++now_;
+            // Cascade from the top down, so timers falling into a lower slot that is also due get cascaded again.
+            unsigned top = 1;
+            while(top < Levels && (now_ & ((uint64_t(1) << (top * SlotBits)) - 1)) == 0) ++top;
+            while(--top) cascade(top);
+        }
+        return fired;
+    }
+    uint64_t now()  const noexcept {return now_;}
+    size_t size()   const noexcept {return size_;}
+    bool empty()    const noexcept {return size_ == 0;}
+}; // timer_wheel
+
+#if __cplusplus < 201703L
+template<typename T, unsigned Levels, unsigned SlotBits>
+constexpr uint32_t timer_wheel<T, Levels, SlotBits>::nil; // std::fill odr-uses it; static constexpr members are implicitly inline only from C++17.
+#endif
+
+} // namespace circ
+
+#endif /* #ifndef CIRCULAR_QUEUE_WHEEL_H__ */